@@ -12,6 +12,15 @@ win32:INCLUDEPATH += "$$(JACK_PATH)\\includes"
 win32:LIBS += $$quote($$(JACK_PATH)\\lib\\libjack.a) $$quote($$(JACK_PATH)\\lib\\libjackserver.a)
 unix:LIBS += -ljack
 
+# "qmake CONFIG+=rtguard" builds a debug binary that reports all allocations,
+# locks and blocking system calls in the process callback (see realtimeguard.h):
+rtguard {
+    DEFINES += ROUNDABOUT_RT_GUARD
+    CONFIG += debug
+    unix:LIBS += -ldl
+    unix:QMAKE_LFLAGS += -rdynamic
+}
+
 TARGET = Roundabout
 TEMPLATE = app
 
@@ -24,7 +33,20 @@ SOURCES += main.cpp\
     roundaboutthread.cpp \
     roundaboutsequencer.cpp \
     roundabouttoken.cpp \
-    roundaboutsegmentdialog.cpp
+    roundaboutsegmentdialog.cpp \
+    midifilewriter.cpp \
+    roundaboutofflinerenderer.cpp \
+    synthetictransport.cpp \
+    roundaboutdriver.cpp \
+    roundaboutjackdriver.cpp \
+    roundaboutnulldriver.cpp \
+    roundaboutloadtest.cpp \
+    stepscheduler.cpp \
+    realtimesemaphore.cpp \
+    realtimeguard.cpp \
+    recordringbuffer.cpp \
+    roundaboutstepstore.cpp \
+    midiclockfollower.cpp
 
 HEADERS  += roundabout.h \
     roundaboutscene.h \
@@ -34,7 +56,22 @@ HEADERS  += roundabout.h \
     ringbuffer.h \
     roundaboutsequencer.h \
     roundabouttoken.h \
-    roundaboutsegmentdialog.h
+    roundaboutsegmentdialog.h \
+    midifilewriter.h \
+    roundaboutofflinerenderer.h \
+    synthetictransport.h \
+    roundaboutdriver.h \
+    roundaboutjackdriver.h \
+    roundaboutnulldriver.h \
+    roundaboutloadtest.h \
+    stepscheduler.h \
+    realtimesemaphore.h \
+    notemask.h \
+    realtimeguard.h \
+    recordringbuffer.h \
+    triplebuffer.h \
+    roundaboutstepstore.h \
+    midiclockfollower.h
 
 FORMS    += roundabout.ui \
     roundaboutsegmentdialog.ui
@@ -19,13 +19,54 @@
 
 #include <QtGui/QApplication>
 #include <QMessageBox>
+#include <cstring>
+#include <cstdlib>
 #include "roundabout.h"
+#include "roundaboutjackdriver.h"
+#include "roundaboutnulldriver.h"
+#include "roundaboutloadtest.h"
 
 int main(int argc, char *argv[])
 {
+    bool useNullDriver = false;
+    int eventQueueCapacity = RoundaboutThread::defaultEventQueueCapacity;
+    int poolSize = RoundaboutThread::defaultPoolSize;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--null-driver") == 0) {
+            useNullDriver = true;
+        } else if ((strcmp(argv[i], "--queue-capacity") == 0) && (i + 1 < argc)) {
+            eventQueueCapacity = qMax(16, atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "--pool-size") == 0) && (i + 1 < argc)) {
+            poolSize = qMax(1, atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "--load-test") == 0) && (i + 2 < argc)) {
+            // headless: neither jack nor a display is needed
+            QCoreApplication a(argc, argv);
+            RoundaboutLoadTest loadTest(atoi(argv[i + 1]), atoi(argv[i + 2]));
+            return loadTest.run();
+        } else if ((strcmp(argv[i], "--step-benchmark") == 0) && (i + 2 < argc)) {
+            QCoreApplication a(argc, argv);
+            RoundaboutLoadTest loadTest(atoi(argv[i + 1]), 0);
+            return loadTest.runStepBenchmark((qint64)atoi(argv[i + 2]) * 1000000);
+        }
+    }
+
     QApplication a(argc, argv);
 
-    RoundaboutThread *thread = new RoundaboutThread();
+    RoundaboutDriver *driver = 0;
+    if (!useNullDriver) {
+        driver = new RoundaboutJackDriver();
+        if (!driver->isValid()) {
+            delete driver;
+            driver = 0;
+            if (QMessageBox::question(0, "Jack not running?", "Could not connect to the Jack server. Please make sure that the Jack server is running.\n\nStart without audio instead?", QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+                return -1;
+            }
+        }
+    }
+    if (!driver) {
+        driver = new RoundaboutNullDriver();
+    }
+    RoundaboutThread *thread = new RoundaboutThread(driver, eventQueueCapacity, poolSize);
     if (!thread->isValid()) {
         QMessageBox::critical(0, "Jack not running?", "Could not connect to the Jack server. Please make sure that the Jack server is running.");
         return -1;
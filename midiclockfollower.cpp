@@ -0,0 +1,176 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "midiclockfollower.h"
+#include <cmath>
+
+// the bandwidth of the loop in Hz (lower is smoother but follows tempo changes more slowly):
+static const double loopBandwidth = 0.5;
+// the loop is started again if no clock arrives for this long (in seconds):
+static const double maxClockGap = 0.5;
+// the time (in seconds) in which differences between the reported position
+// and the loop are corrected, and the maximum correction relative to the
+// distance the position advances in the same time:
+static const double correctionTime = 0.5;
+static const double maxTempoCorrection = 0.05;
+// larger differences (in beats) make the reported position jump:
+static const double maxBeatError = 0.25;
+
+MidiClockFollower::MidiClockFollower(jack_nframes_t sampleRate_) :
+    sampleRate(sampleRate_),
+    locked(false),
+    clockTime(0),
+    clockPeriod(60.0 * sampleRate_ / (120.0 * clocksPerBeat)),
+    clocksSinceLock(0),
+    clock(-1),
+    starting(false),
+    rolling(false),
+    reportedBeat(0),
+    phaseCorrection(0),
+    reportedLocated(false),
+    relocated(false)
+{
+}
+
+void MidiClockFollower::processMessage(quint64 frame, const jack_midi_data_t *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    if (data[0] == 0xF8) {
+        processClock((double)frame);
+    } else if (data[0] == 0xFA) {
+        // start from the beginning of the song with the next clock:
+        clock = -1;
+        starting = true;
+    } else if (data[0] == 0xFB) {
+        // continue from the current song position with the next clock:
+        starting = true;
+    } else if (data[0] == 0xFC) {
+        starting = rolling = false;
+    } else if ((data[0] == 0xF2) && (size >= 3)) {
+        // the song position counts sixteenth notes (six clocks each):
+        int songPosition = (data[1] & 0x7F) | ((data[2] & 0x7F) << 7);
+        clock = (qint64)songPosition * (clocksPerBeat / 4) - 1;
+    }
+}
+
+jack_transport_state_t MidiClockFollower::query(quint64 frame, jack_nframes_t nframes, jack_position_t *position)
+{
+    // give up if the master stopped sending clocks:
+    if (locked && ((double)frame - clockTime > maxClockGap * sampleRate)) {
+        locked = false;
+    }
+    double beatsPerMinute = getBeatsPerMinute();
+    double cycleBeats = beatsPerMinute / 60.0 * (double)nframes / (double)sampleRate;
+    // the tempo is not known before the second clock:
+    bool following = locked && rolling && (clocksSinceLock > 0);
+    phaseCorrection = 0;
+    if (following) {
+        double loopBeat = getLoopBeat(frame);
+        if (!reportedLocated || (fabs(loopBeat - reportedBeat) > maxBeatError)) {
+            relocated = reportedLocated;
+            reportedBeat = loopBeat;
+            reportedLocated = true;
+        }
+        // move a little towards the loop's position in every cycle:
+        double correction = (loopBeat - reportedBeat) * (double)nframes / (correctionTime * (double)sampleRate);
+        double maxCorrection = maxTempoCorrection * cycleBeats;
+        phaseCorrection = qBound(-maxCorrection, correction, maxCorrection);
+        reportedBeat += phaseCorrection;
+    } else {
+        reportedLocated = false;
+    }
+    // report bar, beat and tick like SyntheticTransport (the position is
+    // negative if the first clock after a start is still ahead of us):
+    double bar = floor(reportedBeat / beatsPerBar);
+    double beatInBar = reportedBeat - bar * beatsPerBar;
+    double beat = floor(beatInBar);
+    position->valid = JackPositionBBT;
+    position->frame_rate = sampleRate;
+    position->frame = (jack_nframes_t)frame;
+    position->bar = (int32_t)bar + 1;
+    position->beat = (int32_t)beat + 1;
+    position->tick = (int32_t)((beatInBar - beat) * ticksPerBeat);
+    position->bar_start_tick = bar * beatsPerBar * ticksPerBeat;
+    position->beats_per_bar = beatsPerBar;
+    position->beat_type = 4;
+    position->ticks_per_beat = ticksPerBeat;
+    position->beats_per_minute = beatsPerMinute;
+    if (!following) {
+        return JackTransportStopped;
+    }
+    // the step scheduler advances at the same tempo, so it stays in line with us:
+    reportedBeat += cycleBeats;
+    return JackTransportRolling;
+}
+
+bool MidiClockFollower::takeRelocation()
+{
+    bool result = relocated;
+    relocated = false;
+    return result;
+}
+
+double MidiClockFollower::getPhaseCorrection() const
+{
+    return phaseCorrection;
+}
+
+void MidiClockFollower::processClock(double time)
+{
+    if (!locked || (time - clockTime > maxClockGap * sampleRate)) {
+        // (re)start the loop at this clock:
+        clockTime = time;
+        clocksSinceLock = 0;
+        locked = true;
+    } else if (clocksSinceLock == 0) {
+        // the first period is taken as it is:
+        clockPeriod = qMax(1.0, time - clockTime);
+        clockTime = time;
+        clocksSinceLock++;
+    } else {
+        // second order loop (damping 1 / sqrt(2)):
+        double omega = 2.0 * M_PI * loopBandwidth * clockPeriod / (double)sampleRate;
+        double expectedTime = clockTime + clockPeriod;
+        double error = time - expectedTime;
+        clockTime = expectedTime + M_SQRT2 * omega * error;
+        clockPeriod = qMax(1.0, clockPeriod + omega * omega * error);
+        clocksSinceLock++;
+    }
+    if (starting) {
+        starting = false;
+        rolling = true;
+    }
+    if (rolling) {
+        clock++;
+    }
+}
+
+double MidiClockFollower::getLoopBeat(quint64 frame) const
+{
+    // don't run ahead by more than one clock if the next one is late:
+    double sinceClock = qMin(((double)frame - clockTime) / clockPeriod, 1.0);
+    return ((double)clock + sinceClock) / (double)clocksPerBeat;
+}
+
+double MidiClockFollower::getBeatsPerMinute() const
+{
+    return 60.0 * (double)sampleRate / (clockPeriod * (double)clocksPerBeat);
+}
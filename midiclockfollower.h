@@ -0,0 +1,98 @@
+#ifndef MIDICLOCKFOLLOWER_H
+#define MIDICLOCKFOLLOWER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#include <jack/types.h>
+#include <jack/transport.h>
+#include <jack/midiport.h>
+
+/**
+  Follows the midi clock (24 clocks per quarter note, plus start, continue,
+  stop and song position pointer) of another device and reports it the
+  way a jack timebase master would, so the steps can be scheduled from it.
+
+  The times of the incoming clocks are smoothed by a delay-locked loop
+  (see Fons Adriaensen, "Using a DLL to filter time"), which estimates the
+  clock period and the exact time of the last clock, so the jitter of the
+  individual clocks (e.g. from USB midi) does not reach the tempo.
+  The reported tempo is the smoothed one, so it only changes when a clock
+  arrives. The reported position advances at that tempo and is nudged
+  towards the position of the loop by a small amount per cycle (see
+  getPhaseCorrection()), so it does not jump while the master keeps
+  running. Everything is done in place, without allocating memory.
+ */
+class MidiClockFollower
+{
+public:
+    MidiClockFollower(jack_nframes_t sampleRate);
+
+    /**
+      Processes a clock, start, continue, stop or song position pointer
+      message, other messages are ignored. Messages have to be passed in
+      the order of their frames.
+      @param frame the time of the message in frames, counted continuously
+      */
+    void processMessage(quint64 frame, const jack_midi_data_t *data, size_t size);
+    /**
+      Works like jack_transport_query() for the beginning of a cycle, after
+      the messages of the cycle have been processed. Also advances the
+      reported position to the beginning of the next cycle.
+      @param frame the first frame of the cycle, counted like the message frames
+      */
+    jack_transport_state_t query(quint64 frame, jack_nframes_t nframes, jack_position_t *position);
+    /**
+      @return true if the reported position jumped since the last call
+        (e.g. because the master was restarted while running), then the
+        steps have to be synchronized to it again.
+      */
+    bool takeRelocation();
+    /**
+      @return how far (in beats) the last query() moved the reported position
+        ahead to get closer to the loop (negative if it was moved back).
+        Whatever is scheduled at the reported tempo has to be moved by the
+        same amount to stay in line with the master.
+      */
+    double getPhaseCorrection() const;
+
+private:
+    static const int clocksPerBeat = 24;
+    static const int beatsPerBar = 4;
+    static const int ticksPerBeat = 1920;
+    jack_nframes_t sampleRate;
+    // the loop: the smoothed time of the last clock and the clock period (in frames):
+    bool locked;
+    double clockTime, clockPeriod;
+    int clocksSinceLock;
+    // the last clock, counted from the beginning of the song:
+    qint64 clock;
+    // starting means the next clock is the first one after a start or continue:
+    bool starting, rolling;
+    // the reported position (in beats) at the beginning of the next cycle:
+    double reportedBeat, phaseCorrection;
+    bool reportedLocated, relocated;
+
+    void processClock(double time);
+    double getLoopBeat(quint64 frame) const;
+    double getBeatsPerMinute() const;
+};
+
+#endif // MIDICLOCKFOLLOWER_H
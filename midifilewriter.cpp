@@ -0,0 +1,144 @@
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "midifilewriter.h"
+
+MidiFileWriter::MidiFileWriter(const QString &fileName, quint16 ticksPerBeat_) :
+    file(fileName),
+    ticksPerBeat(ticksPerBeat_),
+    previousTick(0),
+    trackLength(0),
+    success(false)
+{
+}
+
+MidiFileWriter::~MidiFileWriter()
+{
+    if (isOpen()) {
+        close();
+    }
+}
+
+bool MidiFileWriter::open()
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    success = true;
+    previousTick = 0;
+    trackLength = 0;
+    // file header: format 0, one track, ticks per quarter note:
+    write("MThd", 4);
+    writeBigEndian(6, 4);
+    writeBigEndian(0, 2);
+    writeBigEndian(1, 2);
+    writeBigEndian(ticksPerBeat, 2);
+    // track header (the track length is filled in when closing the file):
+    write("MTrk", 4);
+    writeBigEndian(0, 4);
+    // the track length only counts the bytes written from here on:
+    trackLength = 0;
+    return success;
+}
+
+bool MidiFileWriter::isOpen() const
+{
+    return file.isOpen();
+}
+
+quint16 MidiFileWriter::getTicksPerBeat() const
+{
+    return ticksPerBeat;
+}
+
+void MidiFileWriter::writeTempo(quint64 tick, double beatsPerMinute)
+{
+    quint32 microsecondsPerBeat = qBound(1.0, 60000000.0 / beatsPerMinute, (double)0xFFFFFF);
+    writeDeltaTime(tick);
+    write("\xFF\x51\x03", 3);
+    writeBigEndian(microsecondsPerBeat, 3);
+}
+
+void MidiFileWriter::writeEvent(quint64 tick, const jack_midi_data_t *buffer, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    jack_midi_data_t status = buffer[0];
+    if ((status >= 0x80) && (status < 0xF0)) {
+        // channel message:
+        writeDeltaTime(tick);
+        write((const char*)buffer, size);
+    } else if (status == 0xF0) {
+        // system exclusive message (the leading 0xF0 is not counted in the length):
+        writeDeltaTime(tick);
+        write((const char*)buffer, 1);
+        writeVariableLengthQuantity(size - 1);
+        write((const char*)buffer + 1, size - 1);
+    }
+}
+
+bool MidiFileWriter::close()
+{
+    // end of track meta event:
+    writeDeltaTime(previousTick);
+    write("\xFF\x2F\x00", 3);
+    // fill in the track length:
+    quint32 length = trackLength;
+    success = success && file.seek(18);
+    writeBigEndian(length, 4);
+    file.close();
+    return success;
+}
+
+void MidiFileWriter::writeDeltaTime(quint64 tick)
+{
+    quint64 delta = (tick > previousTick ? tick - previousTick : 0);
+    // larger delta times can't be represented, just move them closer:
+    writeVariableLengthQuantity(qMin(delta, (quint64)0x0FFFFFFF));
+    previousTick = qMax(tick, previousTick);
+}
+
+void MidiFileWriter::writeVariableLengthQuantity(quint32 value)
+{
+    // seven bits per byte, most significant first, all but the last byte with bit 7 set:
+    char bytes[4];
+    int count = 0;
+    bytes[3] = value & 0x7F;
+    for (value >>= 7, count = 1; value && (count < 4); value >>= 7, count++) {
+        bytes[3 - count] = (value & 0x7F) | 0x80;
+    }
+    write(bytes + 4 - count, count);
+}
+
+void MidiFileWriter::write(const char *data, qint64 size)
+{
+    success = success && (file.write(data, size) == size);
+    trackLength += size;
+}
+
+void MidiFileWriter::writeBigEndian(quint32 value, int bytes)
+{
+    char buffer[4];
+    for (int i = 0; i < bytes; i++) {
+        buffer[i] = (value >> (8 * (bytes - i - 1))) & 0xFF;
+    }
+    write(buffer, bytes);
+}
@@ -0,0 +1,84 @@
+#ifndef MIDIFILEWRITER_H
+#define MIDIFILEWRITER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <jack/types.h>
+
+/**
+  Writes a Standard MIDI File (format 0, i.e., a single track) by streaming
+  events to disk as they are written, instead of collecting them in memory first.
+  This allows rendering arbitrarily long performances.
+
+  Events have to be written in chronological order. Only channel messages and
+  system exclusive messages are written, all other messages (e.g. realtime
+  messages) can't be stored in a MIDI file and are silently dropped.
+ */
+class MidiFileWriter
+{
+public:
+    MidiFileWriter(const QString &fileName, quint16 ticksPerBeat);
+    ~MidiFileWriter();
+
+    /**
+      Creates the file and writes the file and track headers.
+      @return true if the file could be created, false otherwise.
+      */
+    bool open();
+    bool isOpen() const;
+    quint16 getTicksPerBeat() const;
+
+    /**
+      Writes a tempo change meta event.
+      @param tick the position of the tempo change (in ticks since the beginning).
+      @param beatsPerMinute the new tempo.
+      */
+    void writeTempo(quint64 tick, double beatsPerMinute);
+    /**
+      Writes a midi event.
+      @param tick the position of the event (in ticks since the beginning).
+        Has to be equal to or greater than the position of the previous event.
+      @param buffer the raw midi data of the event.
+      @param size the number of bytes in buffer.
+      */
+    void writeEvent(quint64 tick, const jack_midi_data_t *buffer, size_t size);
+
+    /**
+      Writes the end of track event, fills in the track length and closes the file.
+      This is also done by the destructor if the file is still open.
+      @return true if all data could be written, false otherwise.
+      */
+    bool close();
+
+private:
+    QFile file;
+    quint16 ticksPerBeat;
+    quint64 previousTick;
+    quint32 trackLength;
+    bool success;
+
+    void writeDeltaTime(quint64 tick);
+    void writeVariableLengthQuantity(quint32 value);
+    void write(const char *data, qint64 size);
+    void writeBigEndian(quint32 value, int bytes);
+};
+
+#endif // MIDIFILEWRITER_H
@@ -0,0 +1,113 @@
+#ifndef NOTEMASK_H
+#define NOTEMASK_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+
+/**
+  A fixed size set of up to 128 notes, stored as a bit mask.
+
+  This is a POD type (no constructor, destructor or heap memory), so it
+  can be copied and cleared in the process thread without ever touching
+  the allocator, unlike QBitArray. Note that it is not initialized
+  automatically, call clear() (or use aggregate initialization) first.
+ */
+struct NoteMask
+{
+    static const int size = 128;
+    quint64 bits[2];
+
+    void clear()
+    {
+        bits[0] = bits[1] = 0;
+    }
+    bool isEmpty() const
+    {
+        return !(bits[0] | bits[1]);
+    }
+    bool testBit(int note) const
+    {
+        return (bits[note >> 6] >> (note & 63)) & 1;
+    }
+    void setBit(int note)
+    {
+        bits[note >> 6] |= (quint64)1 << (note & 63);
+    }
+    void clearBit(int note)
+    {
+        bits[note >> 6] &= ~((quint64)1 << (note & 63));
+    }
+    void toggleBit(int note)
+    {
+        bits[note >> 6] ^= (quint64)1 << (note & 63);
+    }
+    /**
+      @return the notes of this mask that are not in the other one.
+      */
+    NoteMask without(const NoteMask &other) const
+    {
+        NoteMask result = { { bits[0] & ~other.bits[0], bits[1] & ~other.bits[1] } };
+        return result;
+    }
+    /**
+      Transposes all notes by the given number of semitones. Notes that
+      end up outside of 0-127 are dropped.
+      */
+    NoteMask shifted(int offset) const
+    {
+        NoteMask result = { { 0, 0 } };
+        if (offset == 0) {
+            result = *this;
+        } else if ((offset > 0) && (offset < 64)) {
+            result.bits[0] = bits[0] << offset;
+            result.bits[1] = (bits[1] << offset) | (bits[0] >> (64 - offset));
+        } else if ((offset >= 64) && (offset < 128)) {
+            result.bits[1] = bits[0] << (offset - 64);
+        } else if ((offset < 0) && (offset > -64)) {
+            result.bits[0] = (bits[0] >> -offset) | (bits[1] << (64 + offset));
+            result.bits[1] = bits[1] >> -offset;
+        } else if ((offset <= -64) && (offset > -128)) {
+            result.bits[0] = bits[1] >> (-offset - 64);
+        }
+        return result;
+    }
+    /**
+      @return the index of the lowest set bit of the given word, which must
+        not be zero. Use this to scan only the set bits of a mask:
+        for (quint64 word = mask.bits[i]; word; word &= word - 1) {
+            int note = i * 64 + NoteMask::lowestBit(word);
+            ...
+        }
+      */
+    static int lowestBit(quint64 word)
+    {
+#ifdef Q_CC_GNU
+        return __builtin_ctzll(word);
+#else
+        int bit = 0;
+        for (; !(word & 1); word >>= 1, bit++);
+        return bit;
+#endif
+    }
+};
+Q_DECLARE_TYPEINFO(NoteMask, Q_PRIMITIVE_TYPE);
+
+#endif // NOTEMASK_H
@@ -0,0 +1,260 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "realtimeguard.h"
+
+#ifdef ROUNDABOUT_RT_GUARD
+
+#include <stdlib.h>
+
+// __GLIBC__ is only defined after including a header of the C library:
+#if defined(__linux__) && defined(__GLIBC__)
+#define INTERPOSE_FUNCTIONS
+
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// set while the current thread is inside a realtime scope:
+static __thread bool realtimeScope = false;
+// set while the current thread is reporting a violation (which itself may allocate etc.):
+static __thread bool reporting = false;
+static volatile int violationCount = 0;
+// only the first violations get a backtrace, to not flood the output of long soak tests:
+static const int maxBacktraces = 64;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+}
+
+/**
+  Looks up the original implementation of an interposed function.
+  */
+template<class T> static T original(T &function, const char *name)
+{
+    if (!function) {
+        function = (T)dlsym(RTLD_NEXT, name);
+    }
+    return function;
+}
+
+static void writeString(const char *string)
+{
+    static ssize_t (*originalWrite)(int, const void *, size_t) = 0;
+    original(originalWrite, "write")(STDERR_FILENO, string, strlen(string));
+}
+
+static void report(const char *function)
+{
+    if (!realtimeScope || reporting) {
+        return;
+    }
+    reporting = true;
+    int count = __sync_add_and_fetch(&violationCount, 1);
+    writeString("RealtimeGuard: ");
+    writeString(function);
+    writeString("() called in the process thread\n");
+    if (count <= maxBacktraces) {
+        void *frames[64];
+        int size = backtrace(frames, 64);
+        // skip report() and the interposed function:
+        backtrace_symbols_fd(frames + 2, size - 2, STDERR_FILENO);
+    }
+    reporting = false;
+}
+
+/**
+  backtrace() loads libgcc when called for the first time, which allocates.
+  Do that when the program starts, not when reporting the first violation.
+  */
+static struct BacktraceInitializer {
+    BacktraceInitializer()
+    {
+        void *frames[1];
+        backtrace(frames, 1);
+    }
+} backtraceInitializer;
+
+extern "C" {
+
+// memory allocation:
+
+void *malloc(size_t size) __THROW
+{
+    report("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    report("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) __THROW
+{
+    report("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) __THROW
+{
+    report("posix_memalign");
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : 12 /* ENOMEM */;
+}
+
+void free(void *pointer) __THROW
+{
+    if (pointer) {
+        report("free");
+    }
+    __libc_free(pointer);
+}
+
+// locks and waiting:
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) __THROWNL
+{
+    static int (*function)(pthread_mutex_t *) = 0;
+    report("pthread_mutex_lock");
+    return original(function, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t *condition, pthread_mutex_t *mutex)
+{
+    static int (*function)(pthread_cond_t *, pthread_mutex_t *) = 0;
+    report("pthread_cond_wait");
+    return original(function, "pthread_cond_wait")(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *condition, pthread_mutex_t *mutex, const struct timespec *time)
+{
+    static int (*function)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *) = 0;
+    report("pthread_cond_timedwait");
+    return original(function, "pthread_cond_timedwait")(condition, mutex, time);
+}
+
+int sem_wait(sem_t *semaphore)
+{
+    static int (*function)(sem_t *) = 0;
+    report("sem_wait");
+    return original(function, "sem_wait")(semaphore);
+}
+
+// QMutex and QWaitCondition (Qt 4.8 on linux) don't use pthreads, they call
+// the futex system call directly when they have to wait:
+
+long syscall(long number, ...) __THROW
+{
+    static long (*function)(long, ...) = 0;
+    va_list list;
+    va_start(list, number);
+    long arguments[6];
+    for (int i = 0; i < 6; i++) {
+        arguments[i] = va_arg(list, long);
+    }
+    va_end(list);
+    if (number == SYS_futex) {
+        int operation = (int)arguments[1] & FUTEX_CMD_MASK;
+        if ((operation == FUTEX_WAIT) || (operation == FUTEX_WAIT_BITSET) || (operation == FUTEX_LOCK_PI)) {
+            report("futex");
+        }
+    }
+    return original(function, "syscall")(number, arguments[0], arguments[1], arguments[2], arguments[3], arguments[4], arguments[5]);
+}
+
+// blocking system calls:
+
+int nanosleep(const struct timespec *time, struct timespec *remaining)
+{
+    static int (*function)(const struct timespec *, struct timespec *) = 0;
+    report("nanosleep");
+    return original(function, "nanosleep")(time, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+    static int (*function)(useconds_t) = 0;
+    report("usleep");
+    return original(function, "usleep")(microseconds);
+}
+
+int poll(struct pollfd *fds, nfds_t count, int timeout)
+{
+    static int (*function)(struct pollfd *, nfds_t, int) = 0;
+    report("poll");
+    return original(function, "poll")(fds, count, timeout);
+}
+
+ssize_t read(int fd, void *buffer, size_t size)
+{
+    static ssize_t (*function)(int, void *, size_t) = 0;
+    report("read");
+    return original(function, "read")(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void *buffer, size_t size)
+{
+    static ssize_t (*function)(int, const void *, size_t) = 0;
+    report("write");
+    return original(function, "write")(fd, buffer, size);
+}
+
+}
+
+#endif // INTERPOSE_FUNCTIONS
+
+RealtimeGuard::RealtimeGuard()
+{
+#ifdef INTERPOSE_FUNCTIONS
+    previous = realtimeScope;
+    realtimeScope = true;
+#endif
+}
+
+RealtimeGuard::~RealtimeGuard()
+{
+#ifdef INTERPOSE_FUNCTIONS
+    realtimeScope = previous;
+#endif
+}
+
+int RealtimeGuard::getViolationCount()
+{
+#ifdef INTERPOSE_FUNCTIONS
+    return violationCount;
+#else
+    return 0;
+#endif
+}
+
+#endif // ROUNDABOUT_RT_GUARD
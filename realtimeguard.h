@@ -0,0 +1,56 @@
+#ifndef REALTIMEGUARD_H
+#define REALTIMEGUARD_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+  Marks a scope as part of the realtime process callback.
+
+  In builds configured with "CONFIG+=rtguard" (which defines
+  ROUNDABOUT_RT_GUARD), every call to the memory allocator, to blocking
+  pthread and semaphore functions, and to blocking system calls that the
+  current thread makes while a guard is alive is reported on stderr with
+  a backtrace. This works by interposing these functions (glibc only).
+  In normal builds a guard does nothing and costs nothing.
+
+  Qt's own mutexes and wait conditions wait through the futex system call
+  instead of pthreads, these waits are caught by interposing syscall().
+  Locking a QMutex that nobody else holds is only an atomic operation and
+  does not show up (but a lock in the process thread is still suspicious).
+ */
+class RealtimeGuard
+{
+public:
+#ifdef ROUNDABOUT_RT_GUARD
+    RealtimeGuard();
+    ~RealtimeGuard();
+    /**
+      @return the number of violations reported so far (in all threads).
+      */
+    static int getViolationCount();
+private:
+    bool previous;
+#else
+    RealtimeGuard() {}
+    static int getViolationCount() { return 0; }
+#endif
+};
+
+#endif // REALTIMEGUARD_H
@@ -0,0 +1,73 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "realtimesemaphore.h"
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach_init.h>
+#include <mach/task.h>
+#else
+#include <errno.h>
+#endif
+
+RealtimeSemaphore::RealtimeSemaphore()
+{
+#if defined(Q_OS_WIN)
+    semaphore = CreateSemaphore(0, 0, 0x7FFFFFFF, 0);
+#elif defined(Q_OS_MAC)
+    semaphore_create(mach_task_self(), &semaphore, SYNC_POLICY_FIFO, 0);
+#else
+    sem_init(&semaphore, 0, 0);
+#endif
+}
+
+RealtimeSemaphore::~RealtimeSemaphore()
+{
+#if defined(Q_OS_WIN)
+    CloseHandle(semaphore);
+#elif defined(Q_OS_MAC)
+    semaphore_destroy(mach_task_self(), semaphore);
+#else
+    sem_destroy(&semaphore);
+#endif
+}
+
+void RealtimeSemaphore::post()
+{
+#if defined(Q_OS_WIN)
+    ReleaseSemaphore(semaphore, 1, 0);
+#elif defined(Q_OS_MAC)
+    semaphore_signal(semaphore);
+#else
+    sem_post(&semaphore);
+#endif
+}
+
+void RealtimeSemaphore::wait()
+{
+#if defined(Q_OS_WIN)
+    WaitForSingleObject(semaphore, INFINITE);
+#elif defined(Q_OS_MAC)
+    semaphore_wait(semaphore);
+#else
+    // restart if interrupted by a signal:
+    for (; (sem_wait(&semaphore) != 0) && (errno == EINTR); );
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef REALTIMESEMAPHORE_H
+#define REALTIMESEMAPHORE_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#if defined(Q_OS_WIN)
+// the semaphore handle is stored as void* to keep windows.h out of this header
+#elif defined(Q_OS_MAC)
+#include <mach/semaphore.h>
+#else
+#include <semaphore.h>
+#endif
+
+/**
+  A counting semaphore that can be posted from the realtime process thread.
+
+  Unlike QWaitCondition::wakeAll() or QSemaphore::release(), which both lock
+  a mutex internally, post() never blocks and never takes a lock. It only enters
+  the kernel if another thread is waiting. Since posts are counted, the waiting
+  thread can't miss a wakeup that happens while it is still busy.
+ */
+class RealtimeSemaphore
+{
+public:
+    RealtimeSemaphore();
+    ~RealtimeSemaphore();
+
+    /**
+      Increments the semaphore, waking up a waiting thread.
+      This is safe to call from the process thread.
+      */
+    void post();
+    /**
+      Waits until the semaphore is greater than zero, then decrements it.
+      */
+    void wait();
+
+private:
+#if defined(Q_OS_WIN)
+    void *semaphore;
+#elif defined(Q_OS_MAC)
+    semaphore_t semaphore;
+#else
+    sem_t semaphore;
+#endif
+};
+
+#endif // REALTIMESEMAPHORE_H
@@ -0,0 +1,117 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recordringbuffer.h"
+#include <string.h>
+
+RecordRingbuffer::RecordRingbuffer(size_t size) :
+    reservedSize(0),
+    peekedSize(0)
+{
+    ringBuffer = jack_ringbuffer_create(size);
+}
+
+RecordRingbuffer::~RecordRingbuffer()
+{
+    jack_ringbuffer_free(ringBuffer);
+}
+
+void * RecordRingbuffer::reserve(size_t size)
+{
+    if (size > getMaximumRecordSize()) {
+        return 0;
+    }
+    size_t recordSize = sizeof(Header) + alignedSize(size);
+    jack_ringbuffer_data_t data[2];
+    jack_ringbuffer_get_write_vector(ringBuffer, data);
+    if (data[0].len < recordSize) {
+        // the record doesn't fit in before the end of the memory, but maybe at the beginning:
+        if (!data[1].len || (data[1].len < recordSize)) {
+            return 0;
+        }
+        // the first part reaches up to the end and the write pointer is aligned, so a header fits:
+        Header *header = (Header*)data[0].buf;
+        header->length = skip;
+        jack_ringbuffer_write_advance(ringBuffer, data[0].len);
+        data[0] = data[1];
+    }
+    Header *header = (Header*)data[0].buf;
+    header->length = size;
+    reservedSize = recordSize;
+    return data[0].buf + sizeof(Header);
+}
+
+void RecordRingbuffer::commit()
+{
+    jack_ringbuffer_write_advance(ringBuffer, reservedSize);
+    reservedSize = 0;
+}
+
+bool RecordRingbuffer::write(const void *data, size_t size)
+{
+    void *payload = reserve(size);
+    if (!payload) {
+        return false;
+    }
+    memcpy(payload, data, size);
+    commit();
+    return true;
+}
+
+const void * RecordRingbuffer::peek(size_t *size)
+{
+    for (;;) {
+        jack_ringbuffer_data_t data[2];
+        jack_ringbuffer_get_read_vector(ringBuffer, data);
+        if (data[0].len < sizeof(Header)) {
+            return 0;
+        }
+        const Header *header = (const Header*)data[0].buf;
+        if (header->length == skip) {
+            // the writer continued at the beginning of the memory:
+            jack_ringbuffer_read_advance(ringBuffer, data[0].len);
+            continue;
+        }
+        *size = header->length;
+        peekedSize = sizeof(Header) + alignedSize(header->length);
+        return data[0].buf + sizeof(Header);
+    }
+}
+
+void RecordRingbuffer::release()
+{
+    jack_ringbuffer_read_advance(ringBuffer, peekedSize);
+    peekedSize = 0;
+}
+
+bool RecordRingbuffer::isEmpty() const
+{
+    return !jack_ringbuffer_read_space(ringBuffer);
+}
+
+size_t RecordRingbuffer::getMaximumRecordSize() const
+{
+    return ringBuffer->size / 2 - sizeof(Header);
+}
+
+size_t RecordRingbuffer::alignedSize(size_t size)
+{
+    // keep all headers aligned (this also makes the payloads 8 byte aligned):
+    return (size + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+}
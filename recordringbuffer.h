@@ -0,0 +1,101 @@
+#ifndef RECORDRINGBUFFER_H
+#define RECORDRINGBUFFER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#include <jack/ringbuffer.h>
+
+/**
+  A single-reader, single-writer lock-free ring buffer for records of
+  variable length, built on jack_ringbuffer_t.
+
+  Each record consists of a small header with its length, followed by
+  the payload. Records are never split at the end of the ring buffer's
+  memory (the writer skips the remaining space with a special header
+  instead), so both the writer and the reader can access a payload in
+  place as one contiguous block, without copying it in or out.
+
+  A record can be at most half as large as the ring buffer, minus the
+  header size.
+ */
+class RecordRingbuffer
+{
+public:
+    RecordRingbuffer(size_t size);
+    ~RecordRingbuffer();
+
+    /**
+      Reserves space for a record with the given payload size. Write the
+      payload to the returned memory and then call commit() to make the
+      record readable. Only one record can be reserved at a time.
+      @return a pointer to the (suitably aligned) payload memory, or 0 if
+        there is not enough space in the ring buffer at the moment.
+      */
+    void * reserve(size_t size);
+    /**
+      Makes the record that was reserved last readable.
+      */
+    void commit();
+    /**
+      Writes a record by copying the given payload.
+      @return true if the record was written, false if there was not
+        enough space.
+      */
+    bool write(const void *data, size_t size);
+
+    /**
+      Takes a look at the next record without removing it from the ring buffer.
+      @param size will be set to the payload size of the record.
+      @return a pointer to the payload of the next record, or 0 if there is
+        no record to read. It stays valid until release() is called.
+      */
+    const void * peek(size_t *size);
+    /**
+      Removes the record that was returned by peek() last.
+      */
+    void release();
+
+    /**
+      @return true if there is no record to read. When called by the
+        writer, this means that the reader is done with all records
+        written so far.
+      */
+    bool isEmpty() const;
+
+    /**
+      @return the largest payload size that a record can have.
+      */
+    size_t getMaximumRecordSize() const;
+
+private:
+    // the length that marks the rest of the memory up to the end as unused:
+    static const quint32 skip = 0xFFFFFFFF;
+    struct Header {
+        quint32 length;
+        quint32 reserved;
+    };
+    jack_ringbuffer_t *ringBuffer;
+    size_t reservedSize, peekedSize;
+
+    static size_t alignedSize(size_t size);
+};
+
+#endif // RECORDRINGBUFFER_H
@@ -20,8 +20,30 @@
     along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QtGlobal>
 #include <jack/ringbuffer.h>
 
+/**
+  Helpers for Ringbuffer, see below.
+  */
+template<size_t size, size_t power = 1, bool done = (power >= size)> struct RingbufferSlotSize
+{
+    static const size_t value = RingbufferSlotSize<size, power * 2>::value;
+};
+template<size_t size, size_t power> struct RingbufferSlotSize<size, power, true>
+{
+    static const size_t value = power;
+};
+template<class T, size_t paddingSize> struct RingbufferSlot
+{
+    T element;
+    char padding[paddingSize];
+};
+template<class T> struct RingbufferSlot<T, 0>
+{
+    T element;
+};
+
 /**
   This is a C++ abstraction over jack_ringbuffer_t.
   It is a template class that allows reading and writing of structs of a given type T.
@@ -29,14 +51,42 @@
   use (with size equal to sizeof(T)).
   E.g., classes with constructor and/or destructor generally don't qualify.
   Simple structs generally do.
+
+  Each element is stored in a slot whose size is the smallest power of two
+  not smaller than sizeof(T). As the size of the underlying jack ring buffer
+  is a power of two as well, no element is ever split at the end of the
+  ring buffer's memory, which allows accessing elements in place through
+  getReadVector() and getWriteVector(). This usually costs no extra memory,
+  because jack rounds the size of the ring buffer up to a power of two anyway.
  */
 
 template<class T> class Ringbuffer
 {
+    typedef RingbufferSlot<T, RingbufferSlotSize<sizeof(T)>::value - sizeof(T)> Slot;
 public:
+    /**
+      A number of elements in the ring buffer's memory, in up to two
+      contiguous parts (the second one starts at the beginning of the
+      memory when the first one reaches its end). The elements can be
+      read or written in place.
+      */
+    class Vector
+    {
+    public:
+        size_t size() const { return count[0] + count[1]; }
+        T & operator[](size_t index)
+        {
+            return (index < count[0] ? part[0][index].element : part[1][index - count[0]].element);
+        }
+    private:
+        friend class Ringbuffer<T>;
+        Slot *part[2];
+        size_t count[2];
+    };
+
     Ringbuffer(size_t size)
     {
-        ringBuffer = jack_ringbuffer_create(size * sizeof(T));
+        ringBuffer = jack_ringbuffer_create(size * sizeof(Slot));
     }
     ~Ringbuffer()
     {
@@ -48,14 +98,45 @@ public:
       */
     size_t readSpace() const
     {
-        return jack_ringbuffer_read_space(ringBuffer) / sizeof(T);
+        return jack_ringbuffer_read_space(ringBuffer) / sizeof(Slot);
     }
     /**
       @return The number of elements of type T that can be written to the ring buffer.
       */
     size_t writeSpace() const
     {
-        return jack_ringbuffer_write_space(ringBuffer) / sizeof(T);
+        return jack_ringbuffer_write_space(ringBuffer) / sizeof(Slot);
+    }
+    /**
+      @return The maximum number of elements of type T the ring buffer can hold.
+      */
+    size_t capacity() const
+    {
+        return (ringBuffer->size - 1) / sizeof(Slot);
+    }
+    /**
+      Gives direct access to all elements that can currently be read,
+      without copying them. Process them in place and then call
+      readAdvance() once with the number of processed elements.
+      @return the readable elements.
+      */
+    Vector getReadVector() const
+    {
+        jack_ringbuffer_data_t data[2];
+        jack_ringbuffer_get_read_vector(ringBuffer, data);
+        return createVector(data);
+    }
+    /**
+      Gives direct access to the free space of the ring buffer. Write the
+      new elements in place and then call writeAdvance() once with the
+      number of written elements to make all of them readable at once.
+      @return the writable elements.
+      */
+    Vector getWriteVector() const
+    {
+        jack_ringbuffer_data_t data[2];
+        jack_ringbuffer_get_write_vector(ringBuffer, data);
+        return createVector(data);
     }
     /**
       Reads a number of entries from the ring buffer.
@@ -69,7 +150,10 @@ public:
       */
     void peek(T *buffer, size_t n)
     {
-        jack_ringbuffer_peek(ringBuffer, (char*)buffer, n * sizeof(T));
+        Vector vector = getReadVector();
+        for (size_t i = 0; (i < n) && (i < vector.size()); i++) {
+            buffer[i] = vector[i];
+        }
     }
     /**
       Takes a look at the next element in the ring buffer.
@@ -83,9 +167,7 @@ public:
       */
     T peek()
     {
-        T element;
-        jack_ringbuffer_peek(ringBuffer, (char*)&element, sizeof(T));
-        return element;
+        return getReadVector()[0];
     }
 
     /**
@@ -98,7 +180,12 @@ public:
       */
     void read(T *buffer, size_t n)
     {
-        jack_ringbuffer_read(ringBuffer, (char*)buffer, n * sizeof(T));
+        Vector vector = getReadVector();
+        n = qMin(n, vector.size());
+        for (size_t i = 0; i < n; i++) {
+            buffer[i] = vector[i];
+        }
+        readAdvance(n);
     }
     /**
       Reads one element from the ring buffer.
@@ -110,8 +197,8 @@ public:
       */
     T read()
     {
-        T element;
-        jack_ringbuffer_read(ringBuffer, (char*)&element, sizeof(T));
+        T element = getReadVector()[0];
+        readAdvance(1);
         return element;
     }
 
@@ -122,7 +209,7 @@ public:
       */
     void readAdvance(size_t n)
     {
-        jack_ringbuffer_read_advance(ringBuffer, n * sizeof(T));
+        jack_ringbuffer_read_advance(ringBuffer, n * sizeof(Slot));
     }
 
     /**
@@ -134,7 +221,12 @@ public:
       */
     void write(const T *buffer, size_t n)
     {
-        jack_ringbuffer_write(ringBuffer, (const char*)buffer, n * sizeof(T));
+        Vector vector = getWriteVector();
+        n = qMin(n, vector.size());
+        for (size_t i = 0; i < n; i++) {
+            vector[i] = buffer[i];
+        }
+        writeAdvance(n);
     }
     /**
       Writes one element to the ring buffer.
@@ -144,7 +236,22 @@ public:
       */
     void write(const T &element)
     {
-        jack_ringbuffer_write(ringBuffer, (const char*)&element, sizeof(T));
+        write(&element, 1);
+    }
+    /**
+      Writes one element to the ring buffer if there is space for it.
+      @param element the element to write to the ring buffer.
+      @return true if the element was written, false if the ring buffer is full.
+      */
+    bool tryWrite(const T &element)
+    {
+        Vector vector = getWriteVector();
+        if (!vector.size()) {
+            return false;
+        }
+        vector[0] = element;
+        writeAdvance(1);
+        return true;
     }
 
     /**
@@ -153,7 +260,7 @@ public:
       */
     void writeAdvance(size_t n)
     {
-        jack_ringbuffer_write_advance(ringBuffer, n * sizeof(T));
+        jack_ringbuffer_write_advance(ringBuffer, n * sizeof(Slot));
     }
     /**
       Resets the ring buffer. Note: this method is NOT thread-safe.
@@ -165,6 +272,16 @@ public:
 
 private:
     jack_ringbuffer_t * ringBuffer;
+
+    static Vector createVector(const jack_ringbuffer_data_t *data)
+    {
+        Vector vector;
+        for (int i = 0; i < 2; i++) {
+            vector.part[i] = (Slot*)data[i].buf;
+            vector.count[i] = data[i].len / sizeof(Slot);
+        }
+        return vector;
+    }
 };
 
 #endif // RINGBUFFER_H
@@ -20,7 +20,14 @@
 #include "roundabout.h"
 #include "ui_roundabout.h"
 #include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QComboBox>
 #include <QLabel>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QElapsedTimer>
 
 Roundabout::Roundabout(RoundaboutThread *thread, QWidget *parent) :
     QMainWindow(parent),
@@ -30,8 +37,8 @@ Roundabout::Roundabout(RoundaboutThread *thread, QWidget *parent) :
 {
     ui->setupUi(this);
     roundaboutThread->setParent(this);
-    // set window title to jack client name:
-    setWindowTitle(roundaboutThread->getJackClientName());
+    // set window title to the client name:
+    setWindowTitle(roundaboutThread->getClientName());
     // put all step tempo buttons into one group (to allow only one of them to be active):
     QActionGroup *toolGroup = new QActionGroup(this);
     toolGroup->addAction(ui->actionFourBeatsPerStep);
@@ -57,6 +64,26 @@ Roundabout::Roundabout(RoundaboutThread *thread, QWidget *parent) :
     ui->mainToolBar->addWidget(outputChannelSpinBox);
     ui->mainToolBar->addSeparator();
     QObject::connect(outputChannelSpinBox, SIGNAL(valueChanged(int)), roundaboutThread, SLOT(setOutputChannel(int)));
+    QAction *separateOutputPortsAction = ui->mainToolBar->addAction("Separate output ports");
+    separateOutputPortsAction->setCheckable(true);
+    separateOutputPortsAction->setToolTip("Send each roundabout to its own MIDI output port");
+    QObject::connect(separateOutputPortsAction, SIGNAL(toggled(bool)), roundaboutThread, SLOT(setSeparateOutputPorts(bool)));
+    ui->mainToolBar->addSeparator();
+    // the internal clock and midi clock input are for setups without a jack timebase master:
+    QComboBox *clockSourceComboBox = new QComboBox(ui->mainToolBar);
+    clockSourceComboBox->addItem("Jack transport", RoundaboutThread::TRANSPORT_CLOCK);
+    clockSourceComboBox->addItem("Internal", RoundaboutThread::INTERNAL_CLOCK);
+    clockSourceComboBox->addItem("MIDI clock input", RoundaboutThread::MIDI_CLOCK);
+    ui->mainToolBar->addWidget(new QLabel("Clock: ", ui->mainToolBar));
+    ui->mainToolBar->addWidget(clockSourceComboBox);
+    QObject::connect(clockSourceComboBox, SIGNAL(currentIndexChanged(int)), roundaboutThread, SLOT(setClockSource(int)));
+    QDoubleSpinBox *tempoSpinBox = new QDoubleSpinBox(ui->mainToolBar);
+    tempoSpinBox->setRange(20, 300);
+    tempoSpinBox->setDecimals(1);
+    tempoSpinBox->setValue(120);
+    ui->mainToolBar->addWidget(new QLabel("Tempo (BPM): ", ui->mainToolBar));
+    ui->mainToolBar->addWidget(tempoSpinBox);
+    QObject::connect(tempoSpinBox, SIGNAL(valueChanged(double)), roundaboutThread, SLOT(setInternalTempo(double)));
 
     ui->graphicsView->setRenderHint(QPainter::Antialiasing);
     // display our RoundaboutScene in the graphics view:
@@ -65,6 +92,16 @@ Roundabout::Roundabout(RoundaboutThread *thread, QWidget *parent) :
     splashScreen.show();
     splashTimer.start(2000);
     QObject::connect(roundaboutThread, SIGNAL(createdSequencer(RoundaboutSequencer*)), &roundaboutScene, SLOT(onCreatedSequencer(RoundaboutSequencer*)));
+    QObject::connect(&roundaboutScene, SIGNAL(deletedSequencer(RoundaboutSequencer*)), roundaboutThread, SLOT(deleteSequencer(RoundaboutSequencer*)));
+    // let the roundabouts show what the process thread is playing (about 25 times per second):
+    QObject::connect(&playheadTimer, SIGNAL(timeout()), &roundaboutScene, SLOT(advance()));
+    playheadTimer.start(40);
+    // show how full the event queues to and from the process thread get:
+    eventQueueLabel = new QLabel(ui->statusBar);
+    ui->statusBar->addPermanentWidget(eventQueueLabel);
+    QObject::connect(&statisticsTimer, SIGNAL(timeout()), this, SLOT(updateEventQueueStatistics()));
+    statisticsTimer.start(1000);
+    updateEventQueueStatistics();
 }
 
 Roundabout::~Roundabout()
@@ -82,6 +119,40 @@ void Roundabout::on_actionCreate_conductor_triggered()
     roundaboutScene.createConductor();
 }
 
+void Roundabout::on_actionRender_midi_file_triggered()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Render MIDI file", QString(), "MIDI files (*.mid)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    bool ok;
+    double beatsPerMinute = QInputDialog::getDouble(this, "Render MIDI file", "Tempo (beats per minute):", 120, 1, 999, 2, &ok);
+    if (!ok) {
+        return;
+    }
+    int bars = QInputDialog::getInt(this, "Render MIDI file", "Length (bars):", 16, 1, 1000000, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    // the dialog is modal, so nothing else can be started while rendering:
+    QProgressDialog progressDialog("Rendering MIDI file...", "Cancel", 0, 100, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+    QObject::connect(roundaboutThread, SIGNAL(renderingProgress(int)), &progressDialog, SLOT(setValue(int)));
+    QObject::connect(&progressDialog, SIGNAL(canceled()), roundaboutThread, SLOT(cancelRendering()));
+    QElapsedTimer timer;
+    timer.start();
+    bool rendered = roundaboutThread->renderMidiFile(fileName, beatsPerMinute, bars);
+    progressDialog.hide();
+    if (rendered) {
+        ui->statusBar->showMessage(QString("Rendered %1 bars to %2 in %3 ms").arg(bars).arg(fileName).arg(timer.elapsed()), 5000);
+    } else if (progressDialog.wasCanceled()) {
+        ui->statusBar->showMessage("Rendering canceled", 5000);
+    } else {
+        QMessageBox::warning(this, "Render MIDI file", QString("Could not write %1.").arg(fileName));
+    }
+}
+
 void Roundabout::on_actionAbout_triggered()
 {
     splashScreen.show();
@@ -108,6 +179,15 @@ void Roundabout::on_actionTwoBeatsPerStep_triggered()
     roundaboutThread->setStepsPerBeat(0.5);
 }
 
+void Roundabout::updateEventQueueStatistics()
+{
+    EventQueueStatistics inbound, outbound;
+    roundaboutThread->getEventQueueStatistics(inbound, outbound);
+    eventQueueLabel->setText(QString("Event queues (peak/size): in %1/%2, %3 deferred; out %4/%5, %6 dropped")
+                             .arg(inbound.highWaterMark).arg(inbound.capacity).arg(inbound.deferredEvents)
+                             .arg(outbound.highWaterMark).arg(outbound.capacity).arg(outbound.droppedEvents));
+}
+
 void Roundabout::on_actionFourBeatsPerStep_triggered()
 {
     roundaboutThread->setStepsPerBeat(0.25);
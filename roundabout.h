@@ -23,6 +23,7 @@
 #include <QMainWindow>
 #include <QSplashScreen>
 #include <QTimer>
+#include <QLabel>
 #include "roundaboutscene.h"
 #include "roundaboutthread.h"
 
@@ -41,6 +42,7 @@ public:
 private slots:
     void on_actionCreate_roundabout_triggered();
     void on_actionCreate_conductor_triggered();
+    void on_actionRender_midi_file_triggered();
     void on_actionAbout_triggered();
 
     void on_actionOneStepPerBeat_triggered();
@@ -53,10 +55,13 @@ private slots:
 
     void on_actionFourBeatsPerStep_triggered();
 
+    void updateEventQueueStatistics();
+
 private:
     Ui::Roundabout *ui;
     QSplashScreen splashScreen;
-    QTimer splashTimer;
+    QTimer splashTimer, statisticsTimer, playheadTimer;
+    QLabel *eventQueueLabel;
     RoundaboutScene roundaboutScene;
     RoundaboutThread *roundaboutThread;
 };
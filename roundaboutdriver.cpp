@@ -0,0 +1,53 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutdriver.h"
+
+RoundaboutDriver::RoundaboutDriver() :
+    processCallback(0),
+    processCallbackArg(0),
+    midiOutputPortCount(1)
+{
+}
+
+RoundaboutDriver::~RoundaboutDriver()
+{
+}
+
+void RoundaboutDriver::setProcessCallback(JackProcessCallback callback, void *arg)
+{
+    processCallback = callback;
+    processCallbackArg = arg;
+}
+
+int RoundaboutDriver::registerMidiOutputPort(const QString &)
+{
+    if (midiOutputPortCount == maxMidiOutputPorts) {
+        return -1;
+    }
+    return midiOutputPortCount++;
+}
+
+int RoundaboutDriver::callProcessCallback(jack_nframes_t nframes)
+{
+    if (processCallback) {
+        return processCallback(nframes, processCallbackArg);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ROUNDABOUTDRIVER_H
+#define ROUNDABOUTDRIVER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QString>
+#include "roundaboutthread.h"
+
+/**
+  Abstraction of the audio/midi backend that calls the process thread.
+
+  A driver owns the midi ports and the transport, and calls the process
+  callback once per cycle from its own (realtime) thread. During the
+  callback it acts as the RoundaboutProcessContext for that cycle.
+ */
+class RoundaboutDriver : public RoundaboutProcessContext
+{
+public:
+    static const int maxMidiOutputPorts = 64;
+    RoundaboutDriver();
+    virtual ~RoundaboutDriver();
+
+    /**
+      Sets the function that will be called once per cycle.
+      This has to be done before calling activate().
+      */
+    void setProcessCallback(JackProcessCallback callback, void *arg);
+
+    /**
+      @return true if the driver could be initialized, false otherwise.
+      */
+    virtual bool isValid() const = 0;
+    virtual QString getClientName() const = 0;
+    virtual jack_nframes_t getSampleRate() const = 0;
+    /**
+      Adds a midi output port, in addition to the one every driver has
+      (port 0). This must not be called from the process thread.
+
+      The default implementation only hands out port indices, for drivers
+      that don't have real ports.
+
+      @param name the name of the new port
+      @return the index of the new port, or -1 if it could not be created.
+      */
+    virtual int registerMidiOutputPort(const QString &name);
+    /**
+      Starts calling the process callback.
+      @return true if successful, false otherwise.
+      */
+    virtual bool activate() = 0;
+
+protected:
+    int callProcessCallback(jack_nframes_t nframes);
+
+private:
+    JackProcessCallback processCallback;
+    void *processCallbackArg;
+    int midiOutputPortCount;
+};
+
+#endif // ROUNDABOUTDRIVER_H
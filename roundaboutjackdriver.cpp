@@ -0,0 +1,140 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutjackdriver.h"
+
+RoundaboutJackDriver::RoundaboutJackDriver(const char *clientName) :
+    client(0),
+    midiInputPort(0),
+    audioOutputPort(0),
+    midiOutputPortCount(0),
+    midiInputBuffer(0),
+    midiOutputBufferCount(0)
+{
+    for (int i = 0; i < maxMidiOutputPorts; i++) {
+        midiOutputPorts[i] = 0;
+        midiOutputBuffers[i] = 0;
+    }
+    // connect to the jack server:
+    client = jack_client_open(clientName, JackNullOption, 0);
+    if (client) {
+        bool success = true;
+        // register process callback:
+        success = success && (jack_set_process_callback(client, process, this) == 0);
+        // register ports:
+        midiInputPort = jack_port_register(client, "midi in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+        midiOutputPorts[0] = jack_port_register(client, "midi out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+        midiOutputPortCount = 1;
+        audioOutputPort = jack_port_register(client, "audio out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        success = success && midiInputPort && midiOutputPorts[0] && audioOutputPort;
+        if (!success) {
+            jack_client_close(client);
+            client = 0;
+        }
+    }
+}
+
+RoundaboutJackDriver::~RoundaboutJackDriver()
+{
+    if (isValid()) {
+        // close the jack client:
+        jack_client_close(client);
+    }
+}
+
+bool RoundaboutJackDriver::isValid() const
+{
+    return client;
+}
+
+QString RoundaboutJackDriver::getClientName() const
+{
+    return QString(jack_get_client_name(client));
+}
+
+jack_nframes_t RoundaboutJackDriver::getSampleRate() const
+{
+    return jack_get_sample_rate(client);
+}
+
+int RoundaboutJackDriver::registerMidiOutputPort(const QString &name)
+{
+    int index = midiOutputPortCount;
+    if (!isValid() || (index == maxMidiOutputPorts)) {
+        return -1;
+    }
+    jack_port_t *port = jack_port_register(client, name.toLocal8Bit().constData(), JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if (!port) {
+        return -1;
+    }
+    midiOutputPorts[index] = port;
+    // let the process thread see the new port only after it has been stored:
+    midiOutputPortCount.fetchAndStoreRelease(index + 1);
+    return index;
+}
+
+bool RoundaboutJackDriver::activate()
+{
+    // start the jack client:
+    if (jack_activate(client) != 0) {
+        jack_client_close(client);
+        client = 0;
+        return false;
+    }
+    return true;
+}
+
+jack_transport_state_t RoundaboutJackDriver::queryTransport(jack_position_t *position)
+{
+    return jack_transport_query(client, position);
+}
+
+jack_nframes_t RoundaboutJackDriver::getMidiInputEventCount()
+{
+    return jack_midi_get_event_count(midiInputBuffer);
+}
+
+void RoundaboutJackDriver::getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index)
+{
+    jack_midi_event_get(event, midiInputBuffer, index);
+}
+
+void RoundaboutJackDriver::writeMidiOutputData(int port, jack_nframes_t time, const jack_midi_data_t *data, size_t size)
+{
+    if ((port >= 0) && (port < midiOutputBufferCount)) {
+        jack_midi_event_write(midiOutputBuffers[port], time, data, size);
+    }
+}
+
+int RoundaboutJackDriver::process(jack_nframes_t nframes)
+{
+    // get midi buffers:
+    midiInputBuffer = jack_port_get_buffer(midiInputPort, nframes);
+    midiOutputBufferCount = midiOutputPortCount.fetchAndAddAcquire(0);
+    for (int i = 0; i < midiOutputBufferCount; i++) {
+        midiOutputBuffers[i] = jack_port_get_buffer(midiOutputPorts[i], nframes);
+        jack_midi_clear_buffer(midiOutputBuffers[i]);
+    }
+    return callProcessCallback(nframes);
+}
+
+int RoundaboutJackDriver::process(jack_nframes_t nframes, void *arg)
+{
+    return ((RoundaboutJackDriver*)arg)->process(nframes);
+}
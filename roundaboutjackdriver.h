@@ -0,0 +1,63 @@
+#ifndef ROUNDABOUTJACKDRIVER_H
+#define ROUNDABOUTJACKDRIVER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutdriver.h"
+
+/**
+  Driver that connects to a running jack server, registers
+  our ports and follows the jack transport.
+ */
+class RoundaboutJackDriver : public RoundaboutDriver
+{
+public:
+    RoundaboutJackDriver(const char *clientName = "Roundabout");
+    virtual ~RoundaboutJackDriver();
+
+    // Reimplemented from RoundaboutDriver:
+    virtual bool isValid() const;
+    virtual QString getClientName() const;
+    virtual jack_nframes_t getSampleRate() const;
+    virtual int registerMidiOutputPort(const QString &name);
+    virtual bool activate();
+
+    // Reimplemented from RoundaboutProcessContext:
+    virtual jack_transport_state_t queryTransport(jack_position_t *position);
+    virtual jack_nframes_t getMidiInputEventCount();
+    virtual void getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index);
+    virtual void writeMidiOutputData(int port, jack_nframes_t time, const jack_midi_data_t *data, size_t size);
+
+private:
+    jack_client_t *client;
+    jack_port_t *midiInputPort, *audioOutputPort;
+    // ports are only ever added, the count tells the process thread how many
+    // of them are ready to use:
+    jack_port_t *midiOutputPorts[maxMidiOutputPorts];
+    QAtomicInt midiOutputPortCount;
+    void *midiInputBuffer, *midiOutputBuffers[maxMidiOutputPorts];
+    int midiOutputBufferCount;
+
+    // Will be called in the jack process thread:
+    int process(jack_nframes_t nframes);
+    static int process(jack_nframes_t nframes, void *arg);
+};
+
+#endif // ROUNDABOUTJACKDRIVER_H
@@ -0,0 +1,223 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutloadtest.h"
+#include "roundaboutthread.h"
+#include "roundaboutsequencer.h"
+#include "roundaboutnulldriver.h"
+#include "roundaboutstepstore.h"
+#include "realtimeguard.h"
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <cstdio>
+
+// the steps as they were kept before the step store, for runStepBenchmark():
+struct PointerSequencer;
+struct PointerStep {
+    NoteMask activeNotes;
+    bool active;
+    PointerSequencer *connection;
+    int connectedStep, branchFrequency, continueFrequency, branchCounter;
+};
+struct PointerSequencer {
+    QVector<PointerStep> steps;
+    int nextStep;
+};
+
+// the same step logic as RoundaboutSequencer::processStepBegin():
+static quint64 walkPointerSteps(PointerSequencer *sequencer, qint64 steps)
+{
+    quint64 checksum = 0;
+    for (qint64 i = 0; i < steps; i++) {
+        int stepCount = sequencer->steps.size();
+        PointerStep &step = sequencer->steps[sequencer->nextStep];
+        if (step.active) {
+            checksum += step.activeNotes.bits[0];
+        }
+        bool branch = step.connection && (step.branchCounter < step.branchFrequency);
+        int sumOfFrequencies = qMax(1, step.branchFrequency + step.continueFrequency);
+        if (step.connection && (sumOfFrequencies != 1)) {
+            step.branchCounter = (step.branchCounter + 1) % sumOfFrequencies;
+        }
+        if (branch) {
+            step.connection->nextStep = step.connectedStep;
+            sequencer = step.connection;
+        } else {
+            sequencer->nextStep = (sequencer->nextStep + 1) % stepCount;
+        }
+    }
+    return checksum;
+}
+
+static quint64 walkStoreSteps(RoundaboutStepStore &store, QVector<int> &nextSteps, int stepCount, qint64 steps)
+{
+    quint64 checksum = 0;
+    int sequencer = 0;
+    for (qint64 i = 0; i < steps; i++) {
+        RoundaboutStep &step = store.getSteps(sequencer)[nextSteps[sequencer]];
+        if (step.active) {
+            checksum += step.activeNotes.bits[0];
+        }
+        bool branch = (step.connection >= 0) && (step.branchCounter < step.branchFrequency);
+        int sumOfFrequencies = qMax(1, step.branchFrequency + step.continueFrequency);
+        if ((step.connection >= 0) && (sumOfFrequencies != 1)) {
+            step.branchCounter = (step.branchCounter + 1) % sumOfFrequencies;
+        }
+        if (branch) {
+            nextSteps[step.connection] = step.connectedStep;
+            sequencer = step.connection;
+        } else {
+            nextSteps[sequencer] = (nextSteps[sequencer] + 1) % stepCount;
+        }
+    }
+    return checksum;
+}
+
+RoundaboutLoadTest::RoundaboutLoadTest(int sequencers_, int seconds_) :
+    sequencers(sequencers_),
+    seconds(seconds_)
+{
+}
+
+int RoundaboutLoadTest::run()
+{
+    QTextStream out(stdout);
+    if (sequencers < 1) {
+        out << "there has to be at least one roundabout\n";
+        return 1;
+    }
+    // run the cycles ourselves instead of in the driver's thread:
+    RoundaboutNullDriver *driver = new RoundaboutNullDriver(RoundaboutNullDriver::MANUAL);
+    // the pool holds exactly the roundabouts of the test:
+    RoundaboutThread thread(driver, RoundaboutThread::defaultEventQueueCapacity, sequencers);
+    // create a chain of roundabouts that hand over to each other after a full round:
+    QVector<RoundaboutSequencer*> roundabouts;
+    for (int i = 0; i < sequencers; i++) {
+        roundabouts.append(thread.createSequencer());
+        // let the process thread pick up the new roundabout:
+        driver->processCycles(1);
+    }
+    for (int i = 0; i < roundabouts.size(); i++) {
+        // send the whole pattern in one record:
+        QVector<NoteMask> notes(RoundaboutSequencer::defaultStepCount);
+        for (int step = 0; step < notes.size(); step++) {
+            notes[step].clear();
+            notes[step].setBit(RoundaboutSequencer::defaultBaseNoteNumber + (i + step) % 13);
+        }
+        thread.setSequencerNotes(roundabouts[i], notes);
+        roundabouts[i]->connect(notes.size() - 1, roundabouts[(i + 1) % roundabouts.size()], 0);
+        driver->processCycles(1);
+    }
+    driver->resetStatistics();
+    quint64 cycles = (quint64)seconds * driver->getSampleRate() / driver->getBufferSize();
+    QElapsedTimer timer;
+    timer.start();
+    driver->processCycles(cycles);
+    qint64 elapsed = timer.elapsed();
+    out << "roundabouts: " << sequencers << "\n";
+    out << "cycles: " << driver->getCycleCount() << " x " << driver->getBufferSize() << " frames at " << driver->getSampleRate() << " Hz\n";
+    out << "rendered " << seconds << " s in " << elapsed << " ms\n";
+    out << "midi output events: " << driver->getMidiOutputEventCount() << "\n";
+    out << "average cycle: " << driver->getAverageCycleTime() << " ns\n";
+    out << "maximum cycle: " << driver->getMaximumCycleTime() << " ns\n";
+    out << "maximum outbound wakeup: " << thread.getMaximumWakeupTime() << " ns\n";
+    EventQueueStatistics inbound, outbound;
+    thread.getEventQueueStatistics(inbound, outbound);
+    out << "inbound events: peak " << inbound.highWaterMark << "/" << inbound.capacity << ", " << inbound.deferredEvents << " deferred\n";
+    out << "outbound events: peak " << outbound.highWaterMark << "/" << outbound.capacity << ", " << outbound.droppedEvents << " dropped\n";
+#ifdef ROUNDABOUT_RT_GUARD
+    out << "realtime violations: " << RealtimeGuard::getViolationCount() << "\n";
+    return RealtimeGuard::getViolationCount() ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int RoundaboutLoadTest::runStepBenchmark(qint64 steps)
+{
+    QTextStream out(stdout);
+    if ((sequencers < 1) || (steps < 1)) {
+        out << "the number of roundabouts and steps have to be positive\n";
+        return 1;
+    }
+    int stepCount = RoundaboutSequencer::defaultStepCount;
+    // chain the roundabouts in random order, so the walk jumps around in memory
+    // (the last step of each one always branches to the next one in the chain):
+    qsrand(1);
+    QVector<int> order(sequencers);
+    for (int i = 0; i < sequencers; i++) {
+        order[i] = i;
+    }
+    for (int i = sequencers - 1; i > 0; i--) {
+        qSwap(order[i], order[qrand() % (i + 1)]);
+    }
+    QVector<int> successor(sequencers);
+    for (int i = 0; i < sequencers; i++) {
+        successor[order[i]] = order[(i + 1) % sequencers];
+    }
+    // before: every roundabout allocates its own steps, in between other allocations
+    // (in the application these are the rest of the roundabout and the GUI items):
+    QVector<PointerSequencer*> pointerSequencers;
+    QVector<QByteArray> otherAllocations;
+    for (int i = 0; i < sequencers; i++) {
+        PointerSequencer *sequencer = new PointerSequencer();
+        sequencer->steps.resize(stepCount);
+        sequencer->nextStep = 0;
+        pointerSequencers.append(sequencer);
+        otherAllocations.append(QByteArray(256 + qrand() % 2048, 0));
+    }
+    for (int i = 0; i < sequencers; i++) {
+        for (int j = 0; j < stepCount; j++) {
+            PointerStep &step = pointerSequencers[i]->steps[j];
+            step.activeNotes.clear();
+            step.activeNotes.setBit(RoundaboutSequencer::defaultBaseNoteNumber + (i + j) % 13);
+            step.active = true;
+            step.connection = (j == stepCount - 1 ? pointerSequencers[successor[i]] : 0);
+            step.connectedStep = 0;
+            step.branchFrequency = 1;
+            step.continueFrequency = step.branchCounter = 0;
+        }
+    }
+    // after: the same patch in the step store:
+    RoundaboutStepStore store(sequencers);
+    QVector<int> nextSteps(sequencers);
+    for (int i = 0; i < sequencers; i++) {
+        store.add(0);
+        RoundaboutStep *storeSteps = store.getSteps(i);
+        for (int j = 0; j < stepCount; j++) {
+            storeSteps[j].activeNotes = pointerSequencers[i]->steps[j].activeNotes;
+        }
+        storeSteps[stepCount - 1].connection = successor[i];
+        storeSteps[stepCount - 1].connectedStep = 0;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    quint64 pointerChecksum = walkPointerSteps(pointerSequencers[0], steps);
+    qint64 pointerTime = timer.nsecsElapsed();
+    timer.restart();
+    quint64 storeChecksum = walkStoreSteps(store, nextSteps, stepCount, steps);
+    qint64 storeTime = timer.nsecsElapsed();
+    qDeleteAll(pointerSequencers);
+    out << "roundabouts: " << sequencers << " with " << stepCount << " steps each\n";
+    out << "steps walked: " << steps << "\n";
+    out << "per-roundabout vectors (before): " << (double)pointerTime / steps << " ns per step\n";
+    out << "step store (after): " << (double)storeTime / steps << " ns per step\n";
+    // both walks have to play the same notes:
+    return (pointerChecksum == storeChecksum) ? 0 : 1;
+}
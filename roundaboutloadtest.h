@@ -0,0 +1,48 @@
+#ifndef ROUNDABOUTLOADTEST_H
+#define ROUNDABOUTLOADTEST_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+
+/**
+  Runs the process thread logic headless on the null driver as fast as
+  possible, with a generated patch of chained roundabouts, and prints
+  cycle timing statistics to stdout. Started with the --load-test
+  command line option, this needs neither jack nor a display.
+ */
+class RoundaboutLoadTest
+{
+public:
+    RoundaboutLoadTest(int sequencers, int seconds);
+    int run();
+    /**
+      Walks the given number of steps through a chain of roundabouts (in
+      random memory order) twice: once with the steps kept like before the
+      step store (one vector per roundabout, connections as pointers) and
+      once in a RoundaboutStepStore, and prints the time per step of both.
+      Started with the --step-benchmark command line option.
+      */
+    int runStepBenchmark(qint64 steps);
+private:
+    int sequencers, seconds;
+};
+
+#endif // ROUNDABOUTLOADTEST_H
@@ -0,0 +1,210 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutnulldriver.h"
+#include <QElapsedTimer>
+#include <string.h>
+
+RoundaboutNullDriver::RoundaboutNullDriver(Mode mode_, jack_nframes_t sampleRate_, jack_nframes_t bufferSize_, QObject *parent) :
+    QThread(parent),
+    mode(mode_),
+    sampleRate(sampleRate_),
+    bufferSize(bufferSize_),
+    shutdown(false),
+    transport(sampleRate_, 120),
+    frameTime(0),
+    transportChangeIndex(0),
+    midiInputBegin(0),
+    midiInputEnd(0),
+    cycleCount(0),
+    midiOutputEventCount(0),
+    maximumCycleTime(0),
+    totalCycleTime(0)
+{
+    midiOutput.reserve(4096);
+}
+
+RoundaboutNullDriver::~RoundaboutNullDriver()
+{
+    shutdown = true;
+    wait();
+}
+
+void RoundaboutNullDriver::addTransportChange(quint64 frame, bool rolling, double beatsPerMinute)
+{
+    TransportChange change;
+    change.frame = frame;
+    change.rolling = rolling;
+    change.beatsPerMinute = beatsPerMinute;
+    // keep the changes sorted by frame:
+    int index = transportChanges.size();
+    for (; (index > 0) && (transportChanges[index - 1].frame > frame); index--);
+    transportChanges.insert(index, change);
+}
+
+void RoundaboutNullDriver::addMidiInputEvent(quint64 frame, const MidiEvent &event)
+{
+    TimedMidiEvent timedEvent;
+    timedEvent.frame = frame;
+    timedEvent.event = event;
+    // keep the events sorted by frame:
+    int index = midiInput.size();
+    for (; (index > 0) && (midiInput[index - 1].frame > frame); index--);
+    midiInput.insert(index, timedEvent);
+}
+
+void RoundaboutNullDriver::processCycles(quint64 cycles)
+{
+    for (quint64 i = 0; i < cycles; i++) {
+        processCycle();
+    }
+}
+
+void RoundaboutNullDriver::resetStatistics()
+{
+    cycleCount = 0;
+    midiOutputEventCount = 0;
+    maximumCycleTime = 0;
+    totalCycleTime = 0;
+}
+
+quint64 RoundaboutNullDriver::getCycleCount() const
+{
+    return cycleCount;
+}
+
+quint64 RoundaboutNullDriver::getMidiOutputEventCount() const
+{
+    return midiOutputEventCount;
+}
+
+qint64 RoundaboutNullDriver::getMaximumCycleTime() const
+{
+    return maximumCycleTime;
+}
+
+qint64 RoundaboutNullDriver::getAverageCycleTime() const
+{
+    return cycleCount ? totalCycleTime / (qint64)cycleCount : 0;
+}
+
+jack_nframes_t RoundaboutNullDriver::getBufferSize() const
+{
+    return bufferSize;
+}
+
+bool RoundaboutNullDriver::isValid() const
+{
+    return true;
+}
+
+QString RoundaboutNullDriver::getClientName() const
+{
+    return QString("Roundabout (no audio)");
+}
+
+jack_nframes_t RoundaboutNullDriver::getSampleRate() const
+{
+    return sampleRate;
+}
+
+bool RoundaboutNullDriver::activate()
+{
+    if (mode != MANUAL) {
+        start(QThread::TimeCriticalPriority);
+    }
+    return true;
+}
+
+jack_transport_state_t RoundaboutNullDriver::queryTransport(jack_position_t *position)
+{
+    return transport.query(position);
+}
+
+jack_nframes_t RoundaboutNullDriver::getMidiInputEventCount()
+{
+    return midiInputEnd - midiInputBegin;
+}
+
+void RoundaboutNullDriver::getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index)
+{
+    TimedMidiEvent &timedEvent = midiInput[midiInputBegin + index];
+    event->time = (jack_nframes_t)(timedEvent.frame - frameTime);
+    event->size = timedEvent.event.size;
+    event->buffer = timedEvent.event.buffer;
+}
+
+void RoundaboutNullDriver::writeMidiOutputData(int, jack_nframes_t time, const jack_midi_data_t *data, size_t size)
+{
+    // the collected events are discarded at the beginning of each cycle
+    // (longer messages like SysEx are only counted):
+    if ((midiOutput.size() < midiOutput.capacity()) && (size <= sizeof(MidiEvent().buffer))) {
+        TimedMidiEvent timedEvent;
+        timedEvent.frame = frameTime + time;
+        timedEvent.event.size = size;
+        memcpy(timedEvent.event.buffer, data, size);
+        midiOutput.append(timedEvent);
+    }
+    midiOutputEventCount++;
+}
+
+void RoundaboutNullDriver::run()
+{
+    // the time (relative to the timer start) at which the next cycle is due, in microseconds:
+    qint64 cycleLength = (qint64)bufferSize * 1000000 / sampleRate;
+    qint64 nextCycle = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (; !shutdown; ) {
+        processCycle();
+        if (mode == REALTIME) {
+            nextCycle += cycleLength;
+            qint64 now = timer.nsecsElapsed() / 1000;
+            if (nextCycle > now) {
+                usleep(nextCycle - now);
+            } else {
+                // we are late (an "xrun"), don't try to catch up:
+                nextCycle = now;
+            }
+        }
+    }
+}
+
+void RoundaboutNullDriver::processCycle()
+{
+    // apply the scripted transport changes:
+    for (; (transportChangeIndex < transportChanges.size()) && (transportChanges[transportChangeIndex].frame <= frameTime); transportChangeIndex++) {
+        const TransportChange &change = transportChanges[transportChangeIndex];
+        transport.setRolling(change.rolling);
+        transport.setBeatsPerMinute(change.beatsPerMinute);
+    }
+    // determine the midi input events of this cycle:
+    midiInputBegin = midiInputEnd;
+    for (; (midiInputEnd < midiInput.size()) && (midiInput[midiInputEnd].frame < frameTime + bufferSize); midiInputEnd++);
+    midiOutput.resize(0);
+    QElapsedTimer timer;
+    timer.start();
+    callProcessCallback(bufferSize);
+    qint64 cycleTime = timer.nsecsElapsed();
+    maximumCycleTime = qMax(maximumCycleTime, cycleTime);
+    totalCycleTime += cycleTime;
+    cycleCount++;
+    transport.advance(bufferSize);
+    frameTime += bufferSize;
+}
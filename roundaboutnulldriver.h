@@ -0,0 +1,122 @@
+#ifndef ROUNDABOUTNULLDRIVER_H
+#define ROUNDABOUTNULLDRIVER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QThread>
+#include <QVector>
+#include "roundaboutdriver.h"
+#include "synthetictransport.h"
+
+/**
+  Driver that doesn't need any audio system. It calls the process callback
+  from its own thread, either paced like a real sound card (REALTIME) or as
+  fast as possible (FREEWHEEL). With MANUAL, no thread is started and cycles
+  are only run synchronously by calling processCycles().
+
+  The transport is synthetic and can be scripted before activation, as can
+  the midi input events. Midi output events (of all ports) are collected in memory.
+  Cycle durations are measured to allow profiling and load testing the
+  process thread without jack.
+ */
+class RoundaboutNullDriver : public QThread, public RoundaboutDriver
+{
+    Q_OBJECT
+public:
+    enum Mode {
+        REALTIME,
+        FREEWHEEL,
+        MANUAL
+    };
+    RoundaboutNullDriver(Mode mode = REALTIME, jack_nframes_t sampleRate = 48000, jack_nframes_t bufferSize = 256, QObject *parent = 0);
+    virtual ~RoundaboutNullDriver();
+
+    /**
+      Schedules a transport change. Has to be called before activation.
+      @param frame the driver's frame time at which the change happens.
+      */
+    void addTransportChange(quint64 frame, bool rolling, double beatsPerMinute);
+    /**
+      Schedules a midi input event. Has to be called before activation.
+      @param frame the driver's frame time at which the event arrives.
+      */
+    void addMidiInputEvent(quint64 frame, const MidiEvent &event);
+
+    /**
+      Runs the given number of cycles in the calling thread.
+      Only use this in MANUAL mode.
+      */
+    void processCycles(quint64 cycles);
+    void resetStatistics();
+
+    quint64 getCycleCount() const;
+    quint64 getMidiOutputEventCount() const;
+    /**
+      @return the duration of the longest cycle so far in nanoseconds.
+      */
+    qint64 getMaximumCycleTime() const;
+    /**
+      @return the average duration of all cycles so far in nanoseconds.
+      */
+    qint64 getAverageCycleTime() const;
+    jack_nframes_t getBufferSize() const;
+
+    // Reimplemented from RoundaboutDriver:
+    virtual bool isValid() const;
+    virtual QString getClientName() const;
+    virtual jack_nframes_t getSampleRate() const;
+    virtual bool activate();
+
+    // Reimplemented from RoundaboutProcessContext:
+    virtual jack_transport_state_t queryTransport(jack_position_t *position);
+    virtual jack_nframes_t getMidiInputEventCount();
+    virtual void getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index);
+    virtual void writeMidiOutputData(int port, jack_nframes_t time, const jack_midi_data_t *data, size_t size);
+
+protected:
+    // Reimplemented from QThread:
+    virtual void run();
+
+private:
+    struct TransportChange {
+        quint64 frame;
+        bool rolling;
+        double beatsPerMinute;
+    };
+    struct TimedMidiEvent {
+        quint64 frame;
+        MidiEvent event;
+    };
+    Mode mode;
+    jack_nframes_t sampleRate, bufferSize;
+    volatile bool shutdown;
+    SyntheticTransport transport;
+    // the driver's frame time (continues while the transport is stopped):
+    quint64 frameTime;
+    QVector<TransportChange> transportChanges;
+    QVector<TimedMidiEvent> midiInput, midiOutput;
+    int transportChangeIndex, midiInputBegin, midiInputEnd;
+    quint64 cycleCount, midiOutputEventCount;
+    qint64 maximumCycleTime, totalCycleTime;
+
+    void processCycle();
+};
+
+#endif // ROUNDABOUTNULLDRIVER_H
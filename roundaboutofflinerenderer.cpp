@@ -0,0 +1,93 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutofflinerenderer.h"
+#include <cmath>
+
+RoundaboutOfflineRenderer::RoundaboutOfflineRenderer(const QString &fileName, jack_nframes_t sampleRate, double beatsPerMinute, int bars) :
+    writer(fileName, midiFileTicksPerBeat),
+    transport(sampleRate, beatsPerMinute, beatsPerBar),
+    endFrame((quint64)((double)(bars * beatsPerBar) * 60.0 * (double)sampleRate / beatsPerMinute))
+{
+}
+
+bool RoundaboutOfflineRenderer::open()
+{
+    if (!writer.open()) {
+        return false;
+    }
+    writer.writeTempo(0, transport.getBeatsPerMinute());
+    return true;
+}
+
+bool RoundaboutOfflineRenderer::close()
+{
+    return writer.close();
+}
+
+bool RoundaboutOfflineRenderer::isFinished() const
+{
+    return transport.getFrame() >= endFrame;
+}
+
+int RoundaboutOfflineRenderer::getProgress() const
+{
+    return (int)(qMin(transport.getFrame(), endFrame) * 100 / qMax(endFrame, (quint64)1));
+}
+
+jack_nframes_t RoundaboutOfflineRenderer::getBufferSize() const
+{
+    if (transport.isRolling()) {
+        return (jack_nframes_t)qMin((quint64)bufferSize, endFrame - transport.getFrame());
+    } else {
+        return bufferSize;
+    }
+}
+
+void RoundaboutOfflineRenderer::advance()
+{
+    transport.advance(getBufferSize());
+}
+
+void RoundaboutOfflineRenderer::stop()
+{
+    transport.setRolling(false);
+}
+
+jack_transport_state_t RoundaboutOfflineRenderer::queryTransport(jack_position_t *position)
+{
+    return transport.query(position);
+}
+
+jack_nframes_t RoundaboutOfflineRenderer::getMidiInputEventCount()
+{
+    return 0;
+}
+
+void RoundaboutOfflineRenderer::getMidiInputEvent(jack_midi_event_t *, jack_nframes_t)
+{
+}
+
+void RoundaboutOfflineRenderer::writeMidiOutputData(int, jack_nframes_t time, const jack_midi_data_t *data, size_t size)
+{
+    // all ports go into the same file (their midi channels still tell them apart):
+    // convert the frame position to midi file ticks:
+    double beat = transport.getBeat(time);
+    writer.writeEvent((quint64)floor(beat * (double)midiFileTicksPerBeat + 0.5), data, size);
+}
@@ -0,0 +1,79 @@
+#ifndef ROUNDABOUTOFFLINERENDERER_H
+#define ROUNDABOUTOFFLINERENDERER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutthread.h"
+#include "midifilewriter.h"
+#include "synthetictransport.h"
+
+/**
+  Drives the process thread logic from a synthetic transport instead of
+  the jack transport and writes all output midi events to a MIDI file.
+
+  The transport starts rolling at bar 1, beat 1 with a fixed tempo and
+  4/4 time signature, and stops after the given number of bars.
+  There is no midi input while rendering.
+ */
+class RoundaboutOfflineRenderer : public RoundaboutProcessContext
+{
+public:
+    RoundaboutOfflineRenderer(const QString &fileName, jack_nframes_t sampleRate, double beatsPerMinute, int bars);
+
+    bool open();
+    bool close();
+
+    /**
+      @return true if the end of the rendered range has been reached.
+      */
+    bool isFinished() const;
+    /**
+      @return how much of the range has been rendered so far, in percent.
+      */
+    int getProgress() const;
+    /**
+      @return the number of frames to process in the current cycle.
+      */
+    jack_nframes_t getBufferSize() const;
+    /**
+      Advances the transport by the size of the current cycle.
+      */
+    void advance();
+    /**
+      Stops the transport.
+      */
+    void stop();
+
+    // Reimplemented from RoundaboutProcessContext:
+    virtual jack_transport_state_t queryTransport(jack_position_t *position);
+    virtual jack_nframes_t getMidiInputEventCount();
+    virtual void getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index);
+    virtual void writeMidiOutputData(int port, jack_nframes_t time, const jack_midi_data_t *data, size_t size);
+
+private:
+    static const jack_nframes_t bufferSize = 4096;
+    static const int beatsPerBar = 4;
+    static const quint16 midiFileTicksPerBeat = 960;
+    MidiFileWriter writer;
+    SyntheticTransport transport;
+    quint64 endFrame;
+};
+
+#endif // ROUNDABOUTOFFLINERENDERER_H
@@ -60,6 +60,18 @@ void RoundaboutTestConnectable::removeConnection()
     disconnected();
 }
 
+void RoundaboutTestConnectable::moveConnectionTo(RoundaboutTestConnectable *connectable)
+{
+    Q_ASSERT(connectionItem && !connectable->connectionItem);
+    RoundaboutTestConnectionItem *item = connectionItem;
+    connectionItem = 0;
+    disconnected();
+    connectable->connectionItem = item;
+    connectable->connectionPoint = connectionPoint;
+    item->replaceConnectable(connectionPoint, connectable);
+    connectable->connected(connectionPoint, item);
+}
+
 void RoundaboutTestConnectable::connected(RoundaboutTestConnectionPoint point, RoundaboutTestConnectionItem *connectionItem)
 {
 }
@@ -117,6 +129,16 @@ RoundaboutTestConnectable * RoundaboutTestConnectionItem::getConnectable(Roundab
     }
 }
 
+void RoundaboutTestConnectionItem::replaceConnectable(RoundaboutTestConnectionPoint point, RoundaboutTestConnectable *connectable)
+{
+    if (point == P1) {
+        connectable1 = connectable;
+    } else {
+        connectable2 = connectable;
+    }
+    movedConnectable(point);
+}
+
 void RoundaboutTestConnectionItem::movedConnectable(RoundaboutTestConnectionPoint  point)
 {
     if (point == P1) {
@@ -270,6 +292,15 @@ void RoundaboutScene::onCreatedSequencer(RoundaboutSequencer *sequencer)
     nextCirclePosition += QPointF(item->rect().width() + 50, 0);
 }
 
+void RoundaboutScene::deleteSequencerItem(RoundaboutSequencerItem *item)
+{
+    item->removeConnectionItems();
+    removeItem(item);
+    deletedSequencer(item->getSequencer());
+    // the item may be deleted from within one of its own event handlers:
+    item->deleteLater();
+}
+
 void RoundaboutScene::onConnected(RoundaboutTestConnectable *p1, RoundaboutTestConnectable *p2)
 {
     RoundaboutTestSegmentItem *segmentItem1 = dynamic_cast<RoundaboutTestSegmentItem*>(p1);
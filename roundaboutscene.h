@@ -25,6 +25,7 @@
 
 class RoundaboutTestConnectionItem;
 class RoundaboutSequencer;
+class RoundaboutSequencerItem;
 
 enum RoundaboutTestConnectionPoint {
     P1,
@@ -41,6 +42,11 @@ public:
     virtual QPointF getConnectionAnchor(RoundaboutTestConnectionPoint point, qreal &angle) const = 0;
     void setConnectionItem(RoundaboutTestConnectionPoint point, RoundaboutTestConnectionItem *connectionItem);
     void removeConnection();
+    /**
+      Hands our connection item over to the given connectable (which must
+      not have one), without disconnecting or connecting any roundabouts.
+      */
+    void moveConnectionTo(RoundaboutTestConnectable *connectable);
 protected:
     virtual void connected(RoundaboutTestConnectionPoint point, RoundaboutTestConnectionItem *connectionItem);
     virtual void disconnected();
@@ -63,6 +69,8 @@ public:
     RoundaboutTestConnectionItem(qreal width, QGraphicsItem *parent = 0, QGraphicsScene *scene = 0);
     void setConnectable(RoundaboutTestConnectionPoint point, RoundaboutTestConnectable *connectable);
     RoundaboutTestConnectable * getConnectable(RoundaboutTestConnectionPoint point);
+    // like setConnectable(), but does not emit connected() or disconnected():
+    void replaceConnectable(RoundaboutTestConnectionPoint point, RoundaboutTestConnectable *connectable);
     void movedConnectable(RoundaboutTestConnectionPoint point);
     void startMove(RoundaboutTestConnectionPoint point);
 signals:
@@ -90,7 +98,13 @@ public:
     explicit RoundaboutScene(QObject *parent = 0);
     RoundaboutTestConnectionItem *createConnectionItem();
     void createConductor();
+    /**
+      Removes the given roundabout and all its connections from the scene,
+      and emits deletedSequencer() so the roundabout itself can be deleted.
+      */
+    void deleteSequencerItem(RoundaboutSequencerItem *item);
 signals:
+    void deletedSequencer(RoundaboutSequencer *sequencer);
 public slots:
     void onCreatedSequencer(RoundaboutSequencer *sequencer);
     void onConnected(RoundaboutTestConnectable *p1, RoundaboutTestConnectable *p2);
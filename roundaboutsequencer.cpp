@@ -18,124 +18,198 @@
  */
 
 #include "roundaboutsequencer.h"
-#include <QDebug>
 
-RoundaboutSequencer::RoundaboutSequencer(QObject *parent) :
+RoundaboutSequencerInboundQueue::RoundaboutSequencerInboundQueue(RoundaboutThread *thread_, size_t capacity) :
+    InboundEventsHelper<RoundaboutSequencerInboundEvent>(capacity),
+    thread(thread_)
+{
+}
+
+void RoundaboutSequencerInboundQueue::processInboundEvent(RoundaboutSequencerInboundEvent &event)
+{
+    if (event.eventType == RoundaboutSequencerInboundEvent::ACTIVATE_SEQUENCER) {
+        thread->processActivateSequencer(event.receiver);
+    } else if (event.eventType == RoundaboutSequencerInboundEvent::DEACTIVATE_SEQUENCER) {
+        thread->processDeactivateSequencer(event.receiver);
+    } else if (event.eventType == RoundaboutSequencerInboundEvent::CHANGE_STEP_COUNT) {
+        event.receiver->processInboundEvent(event);
+        // no step may lead to the removed steps anymore:
+        thread->processRemoveConnections(event.receiver, event.stepCount);
+    } else {
+        event.receiver->processInboundEvent(event);
+    }
+}
+
+RoundaboutSequencer::RoundaboutSequencer(RoundaboutStepStore *store_, RoundaboutSequencerInboundQueue *inboundQueue_, QObject *parent) :
     QObject(parent),
     inputChannel(0),
     outputChannel(0),
-    baseNoteNumber(48),
-    activeBaseNoteNumber(48),
-    activeNotes(13),
+    activeOutputChannel(0),
+    baseNoteNumber(defaultBaseNoteNumber),
+    outputPort(0),
+    activeOutputPort(0),
     stepsPerBeat(4),
     nextStep(0),
-    activeStep(0),
-    steps(16)
+    activeStep(-1),
+    store(store_),
+    inboundQueue(inboundQueue_),
+    index(store->add(this)),
+    stepCount(defaultStepCount),
+    pendingStepCount(defaultStepCount),
+    steps(store->getSteps(index)),
+    snapshotFrame(0)
 {
+    activeNotes.clear();
+    publishSnapshot(0);
+}
+
+int RoundaboutSequencer::getIndex() const
+{
+    return index;
 }
 
 void RoundaboutSequencer::processChangeInputChannel(unsigned char channel)
 {
-    qDebug() << "input channel" << channel;
     inputChannel = channel;
 }
 
 void RoundaboutSequencer::processChangeOutputChannel(unsigned char channel)
 {
-    qDebug() << "output channel" << channel;
     outputChannel = channel;
 }
 
+void RoundaboutSequencer::processSetNotes(const NoteMask *notes, int count)
+{
+    for (int i = 0; (i < count) && (i < stepCount); i++) {
+        steps[i].activeNotes = notes[i];
+    }
+}
+
 void RoundaboutSequencer::setNextStep(int step)
 {
     nextStep = step;
 }
 
-RoundaboutSequencer * RoundaboutSequencer::processStepBegin(QVector<MidiEvent> &output)
+RoundaboutSequencer * RoundaboutSequencer::processStepBegin(jack_nframes_t frame)
 {
-    // determine current step:
+    // switch to a new number of steps between two steps:
+    if (pendingStepCount != stepCount) {
+        applyStepCount();
+    }
+    // we might have been sent to a step that was removed in the meantime:
+    if (nextStep >= stepCount) {
+        nextStep %= stepCount;
+    }
+    // determine current step and its notes (the thread creates the midi events from them):
     activeStep = nextStep;
     if (steps[activeStep].active) {
-        activeNotes = steps[activeStep].activeNotes;
+        activeNotes = steps[activeStep].activeNotes.shifted((int)baseNoteNumber - defaultBaseNoteNumber);
     } else {
-        activeNotes.fill(false);
-    }
-    activeBaseNoteNumber = baseNoteNumber;
-    // send step entered event:
-    RoundaboutSequencerOutboundEvent event;
-    event.eventType = RoundaboutSequencerOutboundEvent::ENTERED_STEP;
-    event.step = nextStep;
-    writeOutboundEvent(event);
-    // create midi note on events:
-    for (int note = 0; note < activeNotes.size(); note++) {
-        if (activeNotes[note]) {
-            output.append(MidiNoteOnEvent(outputChannel, qBound(0, activeBaseNoteNumber + note, 127), 127));
-        }
+        activeNotes.clear();
     }
+    activeOutputChannel = outputChannel;
+    activeOutputPort = outputPort;
     // determine next step (maybe in another roundabout):
     RoundaboutSequencer *nextSequencer = this;
-    bool branch = steps[nextStep].connection && (steps[nextStep].branchCounter < steps[nextStep].branchFrequency);
+    bool branch = (steps[nextStep].connection >= 0) && (steps[nextStep].branchCounter < steps[nextStep].branchFrequency);
     int sumOfFrequencies = qMax(1, steps[nextStep].branchFrequency + steps[nextStep].continueFrequency);
-    if (steps[nextStep].connection && (sumOfFrequencies != 1)) {
+    if ((steps[nextStep].connection >= 0) && (sumOfFrequencies != 1)) {
         steps[nextStep].branchCounter = (steps[nextStep].branchCounter + 1) % sumOfFrequencies;
-        // signal the branch counter change:
-        RoundaboutSequencerOutboundEvent event;
-        event.eventType = RoundaboutSequencerOutboundEvent::CHANGED_BRANCH_COUNTER;
-        event.step = nextStep;
-        event.branchCounter = steps[nextStep].branchCounter;
-        writeOutboundEvent(event);
     }
     if (branch) {
         Step &step = steps[nextStep];
-        step.connection->setNextStep(step.connectedStep);
-        nextSequencer = step.connection;
+        nextSequencer = store->getSequencer(step.connection);
+        nextSequencer->setNextStep(step.connectedStep);
     } else {
-        nextStep = (nextStep + 1) % steps.size();
+        nextStep = (nextStep + 1) % stepCount;
     }
+    publishSnapshot(frame);
     // return next roundabout:
     return nextSequencer;
 }
 
-void RoundaboutSequencer::processStepEnd(QVector<MidiEvent> &output)
+void RoundaboutSequencer::processStepEnd(jack_nframes_t frame)
 {
     if (activeStep >= 0) {
-        // send step left event:
-        RoundaboutSequencerOutboundEvent event;
-        event.eventType = RoundaboutSequencerOutboundEvent::LEFT_STEP;
-        event.step = activeStep;
-        writeOutboundEvent(event);
-        // create midi note off events:
-        for (int note = 0; note < activeNotes.size(); note++) {
-            if (activeNotes[note]) {
-                output.append(MidiNoteOffEvent(outputChannel, qBound(0, activeBaseNoteNumber + note, 127), 127));
-            }
-        }
+        activeNotes.clear();
         activeStep = -1;
+        publishSnapshot(frame);
     }
 }
 
-void RoundaboutSequencer::processStop(QVector<MidiEvent> &output)
+void RoundaboutSequencer::processStop()
 {
-    processStepEnd(output);
+    processStepEnd(snapshotFrame);
     // reset position:
     setNextStep(0);
     // reset branch counters:
-    for (int i = 0; i < steps.size(); i++) {
+    for (int i = 0; i < stepCount; i++) {
         steps[i].branchCounter = 0;
     }
+    publishSnapshot(snapshotFrame);
 }
 
-void RoundaboutSequencer::processMidiEvents(const QVector<MidiEvent> &input)
+void RoundaboutSequencer::processContinueAfterActiveStep()
 {
-    for (int i = 0; i < input.size(); i++) {
-        // interpret midi note on events to set the base note number:
-        const MidiEvent &event = input[i];
-        if (((event.buffer[0] & 0x0F) == inputChannel) && ((event.buffer[0] & 0xF0) == 0x90)) {
-            baseNoteNumber = event.buffer[1];
+    if (activeStep >= 0) {
+        // wraps around in processStepBegin():
+        setNextStep(activeStep + 1);
+    }
+}
+
+void RoundaboutSequencer::processRemoveConnections(int sequencerIndex, int firstStep)
+{
+    for (int i = 0; i < maxStepCount; i++) {
+        if ((steps[i].connection == sequencerIndex) && (steps[i].connectedStep >= firstStep)) {
+            steps[i].connection = -1;
         }
     }
 }
 
+void RoundaboutSequencer::reset()
+{
+    inputChannel = outputChannel = activeOutputChannel = 0;
+    baseNoteNumber = defaultBaseNoteNumber;
+    outputPort = activeOutputPort = 0;
+    activeNotes.clear();
+    stepsPerBeat = 4;
+    nextStep = 0;
+    activeStep = -1;
+    stepCount = pendingStepCount = defaultStepCount;
+    store->reset(index);
+    snapshotFrame = 0;
+    publishSnapshot(0);
+}
+
+const NoteMask & RoundaboutSequencer::getActiveNotes() const
+{
+    return activeNotes;
+}
+
+unsigned char RoundaboutSequencer::getActiveOutputChannel() const
+{
+    return activeOutputChannel;
+}
+
+int RoundaboutSequencer::getActiveOutputPort() const
+{
+    return activeOutputPort;
+}
+
+unsigned char RoundaboutSequencer::getMidiInputSubscription() const
+{
+    // note on events on the input channel:
+    return 0x90 | inputChannel;
+}
+
+void RoundaboutSequencer::processMidiEvent(const jack_midi_event_t &event)
+{
+    // interpret midi note on events to set the base note number:
+    if (event.size >= 2) {
+        baseNoteNumber = event.buffer[1];
+    }
+}
+
 void RoundaboutSequencer::toggleStep(int step)
 {
     RoundaboutSequencerInboundEvent event;
@@ -178,17 +252,61 @@ void RoundaboutSequencer::setStepBranchFrequency(int step, int branchFrequency,
     writeInboundEvent(event);
 }
 
+void RoundaboutSequencer::setOutputPort(int port)
+{
+    RoundaboutSequencerInboundEvent event;
+    event.eventType = RoundaboutSequencerInboundEvent::CHANGE_OUTPUT_PORT;
+    event.outputPort = port;
+    writeInboundEvent(event);
+}
+
+void RoundaboutSequencer::setOutputChannel(int channel)
+{
+    RoundaboutSequencerInboundEvent event;
+    event.eventType = RoundaboutSequencerInboundEvent::CHANGE_OUTPUT_CHANNEL;
+    event.outputChannel = qBound(0, channel, 15);
+    writeInboundEvent(event);
+}
+
+void RoundaboutSequencer::setStepCount(int stepCount)
+{
+    RoundaboutSequencerInboundEvent event;
+    event.eventType = RoundaboutSequencerInboundEvent::CHANGE_STEP_COUNT;
+    event.stepCount = qBound((int)minStepCount, stepCount, (int)maxStepCount);
+    writeInboundEvent(event);
+}
+
 void RoundaboutSequencer::processInboundEvent(RoundaboutSequencerInboundEvent &event)
 {
-    Q_ASSERT((event.step >= 0) && (event.step < steps.size()));
+    if (event.eventType == RoundaboutSequencerInboundEvent::CHANGE_OUTPUT_PORT) {
+        outputPort = event.outputPort;
+        return;
+    } else if (event.eventType == RoundaboutSequencerInboundEvent::CHANGE_OUTPUT_CHANNEL) {
+        outputChannel = event.outputChannel;
+        return;
+    } else if (event.eventType == RoundaboutSequencerInboundEvent::CHANGE_STEP_COUNT) {
+        pendingStepCount = event.stepCount;
+        // removed steps start from the defaults if they are added again, like
+        // the GUI shows them (none of them is entered anymore before the switch):
+        store->reset(index, pendingStepCount);
+        // if we are not playing there is no step boundary to wait for:
+        if (activeStep < 0) {
+            applyStepCount();
+            publishSnapshot(snapshotFrame);
+        }
+        return;
+    }
+    // steps beyond the current number of steps may be edited as well (the
+    // GUI might already show a new number of steps that is still pending):
+    Q_ASSERT((event.step >= 0) && (event.step < maxStepCount));
     if (event.eventType == RoundaboutSequencerInboundEvent::TOGGLE_STEP) {
         steps[event.step].active = !steps[event.step].active;
     } else if (event.eventType == RoundaboutSequencerInboundEvent::TOGGLE_NOTE) {
-        Q_ASSERT((event.note >= 0) && (event.note < steps[event.step].activeNotes.size()));
+        Q_ASSERT((event.note >= 0) && (event.note < NoteMask::size));
         steps[event.step].activeNotes.toggleBit(event.note);
     } else if (event.eventType == RoundaboutSequencerInboundEvent::CONNECT_STEP) {
-        Q_ASSERT(!event.sequencer || ((event.connectedStep >= 0) && (event.connectedStep < event.sequencer->steps.size())));
-        steps[event.step].connection = event.sequencer;
+        Q_ASSERT(!event.sequencer || ((event.connectedStep >= 0) && (event.connectedStep < maxStepCount)));
+        steps[event.step].connection = (event.sequencer ? event.sequencer->index : -1);
         steps[event.step].connectedStep = event.connectedStep;
     } else if (event.eventType == RoundaboutSequencerInboundEvent::CHANGE_STEP_BRANCH_FREQUENCY) {
         steps[event.step].branchFrequency = event.branchFrequency;
@@ -197,14 +315,41 @@ void RoundaboutSequencer::processInboundEvent(RoundaboutSequencerInboundEvent &e
     }
 }
 
-void RoundaboutSequencer::processOutboundEvent(RoundaboutSequencerOutboundEvent &event)
+bool RoundaboutSequencer::updateSnapshot()
+{
+    return snapshot.update();
+}
+
+const RoundaboutSequencer::Snapshot & RoundaboutSequencer::getSnapshot() const
 {
-    if (event.eventType == RoundaboutSequencerOutboundEvent::ENTERED_STEP) {
-        enteredStep(event.step);
-    } else if (event.eventType == RoundaboutSequencerOutboundEvent::LEFT_STEP) {
-        leftStep(event.step);
-    } else if (event.eventType == RoundaboutSequencerOutboundEvent::CHANGED_BRANCH_COUNTER) {
-        changedBranchCounter(event.step, event.branchCounter);
+    return snapshot.getReadBuffer();
+}
+
+void RoundaboutSequencer::publishSnapshot(jack_nframes_t frame)
+{
+    Snapshot &state = snapshot.getWriteBuffer();
+    state.activeStep = activeStep;
+    state.stepCount = stepCount;
+    for (int i = 0; i < stepCount; i++) {
+        state.branchCounters[i] = steps[i].branchCounter;
     }
+    state.activeNotes = activeNotes;
+    state.frame = frame;
+    snapshot.publish();
+    snapshotFrame = frame;
+}
+
+void RoundaboutSequencer::writeInboundEvent(RoundaboutSequencerInboundEvent &event)
+{
+    event.receiver = this;
+    inboundQueue->writeInboundEvent(event);
+}
+
+void RoundaboutSequencer::applyStepCount()
+{
+    // the steps stay where they are in the step store, added ones have
+    // their default values (see CHANGE_STEP_COUNT) or the edits they got since:
+    stepCount = pendingStepCount;
+    nextStep %= stepCount;
 }
 
@@ -21,8 +21,10 @@
  */
 
 #include <QObject>
-#include <QBitArray>
 #include "roundaboutthread.h"
+#include "notemask.h"
+#include "triplebuffer.h"
+#include "roundaboutstepstore.h"
 
 class RoundaboutSequencer;
 
@@ -31,71 +33,196 @@ struct RoundaboutSequencerInboundEvent {
         TOGGLE_STEP,
         TOGGLE_NOTE,
         CONNECT_STEP,
-        CHANGE_STEP_BRANCH_FREQUENCY
+        CHANGE_STEP_BRANCH_FREQUENCY,
+        CHANGE_OUTPUT_PORT,
+        CHANGE_OUTPUT_CHANNEL,
+        CHANGE_STEP_COUNT,
+        // these are handled by the RoundaboutThread:
+        ACTIVATE_SEQUENCER,
+        DEACTIVATE_SEQUENCER
     } eventType;
-    int step, note, connectedStep, branchFrequency, continueFrequency;
+    int step, note, connectedStep, branchFrequency, continueFrequency, outputPort, stepCount;
+    unsigned char outputChannel;
     RoundaboutSequencer *sequencer;
+    // the roundabout this event is meant for:
+    RoundaboutSequencer *receiver;
 };
-struct RoundaboutSequencerOutboundEvent {
-    enum EventType {
-        ENTERED_STEP,
-        LEFT_STEP,
-        CHANGED_BRANCH_COUNTER
-    } eventType;
-    int step, branchCounter;
+
+/**
+  The inbound events of all roundabouts share this queue (owned by the
+  RoundaboutThread), so the memory used for queues doesn't grow with the
+  number of roundabouts. Each event is handed to its receiver, except for
+  activating and deactivating a roundabout, which the thread takes care of.
+  So these are always processed in order with the roundabout's edits.
+  The thread also removes the connections to steps that a change of the
+  number of steps removes.
+  */
+class RoundaboutSequencerInboundQueue : public InboundEventsHelper<RoundaboutSequencerInboundEvent>
+{
+public:
+    RoundaboutSequencerInboundQueue(RoundaboutThread *thread, size_t capacity);
+protected:
+    // Reimplemented from InboundEventsHelper:
+    virtual void processInboundEvent(RoundaboutSequencerInboundEvent &event);
+private:
+    RoundaboutThread *thread;
 };
 
-class RoundaboutSequencer : public QObject, public InboundEventsHelper<RoundaboutSequencerInboundEvent>, public OutboundEventsHelper<RoundaboutSequencerOutboundEvent>
+class RoundaboutSequencer : public QObject
 {
     Q_OBJECT
 public:
-    class Step {
-    public:
-        Step() :
-            active(true),
-            activeNotes(13),
-            connection(0),
-            connectedStep(0),
-            branchFrequency(1),
-            continueFrequency(0),
-            branchCounter(0)
-        {}
-        bool active;
-        QBitArray activeNotes;
-        RoundaboutSequencer *connection;
-        int connectedStep;
-        int branchFrequency, continueFrequency, branchCounter;
+    typedef RoundaboutStep Step;
+    /**
+      The state of the sequencer as seen by the process thread, published
+      whenever it changes (see getSnapshot()).
+      */
+    struct Snapshot {
+        // -1 if no step is active:
+        int activeStep;
+        // the number of steps the process thread is using:
+        int stepCount;
+        int branchCounters[RoundaboutStepStore::maxStepsPerSequencer];
+        // the (transposed) notes that are currently held:
+        NoteMask activeNotes;
+        // the transport frame at which this state was reached:
+        jack_nframes_t frame;
     };
-    RoundaboutSequencer(QObject *parent = 0);
+    // step notes are played as they are while the base note number is this,
+    // other base note numbers transpose them:
+    static const int defaultBaseNoteNumber = 48;
+    static const int minStepCount = 3;
+    static const int maxStepCount = RoundaboutStepStore::maxStepsPerSequencer;
+    static const int defaultStepCount = 16;
+    /**
+      Creates a roundabout whose steps are kept in the given store.
+      The store must not be full.
+
+      @param inboundQueue the queue for events to the process thread
+      */
+    RoundaboutSequencer(RoundaboutStepStore *store, RoundaboutSequencerInboundQueue *inboundQueue, QObject *parent = 0);
+
+    /**
+      @return the index of this roundabout in its step store.
+      */
+    int getIndex() const;
 
     void processChangeInputChannel(unsigned char channel);
     void processChangeOutputChannel(unsigned char channel);
+    /**
+      Sets the notes of the first count steps (superfluous notes are ignored).
+      */
+    void processSetNotes(const NoteMask *notes, int count);
     void setNextStep(int step);
 
-    virtual RoundaboutSequencer * processStepBegin(QVector<MidiEvent> &output);
-    virtual void processStepEnd(QVector<MidiEvent> &output);
-    void processStop(QVector<MidiEvent> &output);
-    virtual void processMidiEvents(const QVector<MidiEvent> &input);
-protected:
-    // Reimplemented from InboundEventsHelper:
-    virtual void processInboundEvent(RoundaboutSequencerInboundEvent &event);
-    // Reimplemented from OutboundEventsHelper:
-    virtual void processOutboundEvent(RoundaboutSequencerOutboundEvent &event);
-signals:
-    void enteredStep(int step);
-    void leftStep(int step);
-    void changedBranchCounter(int step, int branchCounter);
+    /**
+      Enters the next step.
+
+      @param frame the transport frame at which the step begins
+      @return the sequencer which will play the step after this one
+      */
+    virtual RoundaboutSequencer * processStepBegin(jack_nframes_t frame);
+    /**
+      Leaves the current step (if any).
+
+      @param frame the transport frame at which the step ends
+      */
+    virtual void processStepEnd(jack_nframes_t frame);
+    void processStop();
+    /**
+      Lets the step after the current one follow next, for when the
+      roundabout that the current step branched to is deleted before the
+      playhead gets there (the branch left the next step where it was).
+      */
+    void processContinueAfterActiveStep();
+    /**
+      Removes all connections from the steps of this roundabout to the
+      roundabout with the given index (because that one is being deleted).
+      This includes the steps beyond the current number of steps, which
+      may be added again later.
+
+      @param firstStep only the connections to this step of the other
+        roundabout or to steps after it are removed (because that one
+        got fewer steps)
+      */
+    void processRemoveConnections(int sequencerIndex, int firstStep = 0);
+    /**
+      Brings this roundabout back into the state it was created in, so it
+      can be reused after it was deleted. This must only be called when the
+      process thread does not know about this roundabout (anymore).
+      */
+    void reset();
+    /**
+      @return the (transposed) notes of the current step, which are empty
+        when no step is active.
+      */
+    const NoteMask & getActiveNotes() const;
+    unsigned char getActiveOutputChannel() const;
+    /**
+      @return the midi output port the notes of the current step go to.
+      */
+    int getActiveOutputPort() const;
+    /**
+      @return the status byte (message type and channel) of the midi input
+        events this sequencer wants to receive through processMidiEvent().
+      */
+    unsigned char getMidiInputSubscription() const;
+    /**
+      Fetches the latest snapshot published by the process thread. This never
+      blocks and costs the same no matter how many steps were played since
+      the last call, but it must only be called from one (the GUI) thread.
+
+      @return true if the snapshot changed since the last call
+      */
+    bool updateSnapshot();
+    /**
+      @return the snapshot fetched by the last call to updateSnapshot().
+      */
+    const Snapshot & getSnapshot() const;
+    virtual void processMidiEvent(const jack_midi_event_t &event);
+    // Called by RoundaboutSequencerInboundQueue in the process thread:
+    void processInboundEvent(RoundaboutSequencerInboundEvent &event);
 public slots:
     void toggleStep(int step);
     void toggleNote(int step, int note);
     void connect(int step, RoundaboutSequencer *sequencer, int connectedStep);
     void disconnect(int step);
     void setStepBranchFrequency(int step, int branchFrequency, int continueFrequency);
+    /**
+      Sends the notes of this roundabout to the given midi output port
+      (see RoundaboutThread::registerMidiOutputPort()), from the next step on.
+      */
+    void setOutputPort(int port);
+    void setOutputChannel(int channel);
+    /**
+      Changes the number of steps (between minStepCount and maxStepCount).
+      The process thread switches to the new number at the next step
+      boundary (or right away if no step is active). Removed steps are reset
+      to their default values right away, so steps that are added again
+      start out active, without notes and without a connection,
+      like the GUI creates them.
+      When the process thread gets the new number, it removes all
+      connections (of any roundabout) to the removed steps. Only a branch
+      that was taken before that leads to the step number modulo the new count.
+      */
+    void setStepCount(int stepCount);
 private:
-    unsigned char inputChannel, outputChannel, baseNoteNumber, activeBaseNoteNumber;
-    QBitArray activeNotes;
+    unsigned char inputChannel, outputChannel, activeOutputChannel, baseNoteNumber;
+    int outputPort, activeOutputPort;
+    NoteMask activeNotes;
     int stepsPerBeat, nextStep, activeStep;
-    QVector<Step> steps;
+    RoundaboutStepStore *store;
+    RoundaboutSequencerInboundQueue *inboundQueue;
+    int index, stepCount, pendingStepCount;
+    // points into the step store:
+    Step *steps;
+    // the latest state for the GUI thread, and the frame it was last published at:
+    TripleBuffer<Snapshot> snapshot;
+    jack_nframes_t snapshotFrame;
+
+    void writeInboundEvent(RoundaboutSequencerInboundEvent &event);
+    void publishSnapshot(jack_nframes_t frame);
+    void applyStepCount();
 };
 
 #endif // ROUNDABOUTSEQUENCER_H
@@ -0,0 +1,68 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roundaboutstepstore.h"
+
+// make sure that each step fills exactly one cache line:
+typedef char RoundaboutStepSizeCheck[sizeof(RoundaboutStep) == 64 ? 1 : -1];
+
+RoundaboutStepStore::RoundaboutStepStore(int capacity_) :
+    capacity(capacity_),
+    size(0)
+{
+    steps = (RoundaboutStep*)qMallocAligned(capacity * maxStepsPerSequencer * sizeof(RoundaboutStep), sizeof(RoundaboutStep));
+    sequencers = new RoundaboutSequencer*[capacity];
+}
+
+RoundaboutStepStore::~RoundaboutStepStore()
+{
+    qFreeAligned(steps);
+    delete [] sequencers;
+}
+
+int RoundaboutStepStore::getCapacity() const
+{
+    return capacity;
+}
+
+bool RoundaboutStepStore::isFull() const
+{
+    return size == capacity;
+}
+
+int RoundaboutStepStore::add(RoundaboutSequencer *sequencer)
+{
+    if (isFull()) {
+        return -1;
+    }
+    int index = size++;
+    sequencers[index] = sequencer;
+    reset(index);
+    return index;
+}
+
+void RoundaboutStepStore::reset(int index, int firstStep)
+{
+    // active, no notes, no connection, always branch:
+    RoundaboutStep step = { { { 0, 0 } }, true, -1, 0, 1, 0, 0, { 0 } };
+    RoundaboutStep *sequencerSteps = getSteps(index);
+    for (int i = firstStep; i < maxStepsPerSequencer; i++) {
+        sequencerSteps[i] = step;
+    }
+}
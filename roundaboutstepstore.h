@@ -0,0 +1,100 @@
+#ifndef ROUNDABOUTSTEPSTORE_H
+#define ROUNDABOUTSTEPSTORE_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#include "notemask.h"
+
+class RoundaboutSequencer;
+
+/**
+  A single step of a roundabout. A POD type of exactly one cache line
+  (see the padding), so a step can be read and advanced in the process
+  thread by touching a single cache line, and it can be copied without
+  allocating memory. See RoundaboutStepStore::add() for the default values.
+  */
+struct RoundaboutStep {
+    NoteMask activeNotes;
+    bool active;
+    // the index of the connected roundabout in the step store (-1 if none):
+    qint32 connection;
+    qint32 connectedStep;
+    qint32 branchFrequency, continueFrequency, branchCounter;
+    char padding[64 - sizeof(NoteMask) - 6 * sizeof(qint32)];
+};
+
+/**
+  Holds the steps of all roundabouts in one contiguous, cache line aligned
+  block of memory that is allocated once, so walking from step to step
+  (and from roundabout to roundabout) never chases pointers across the heap.
+  Roundabouts refer to each other by their index in the store.
+
+  Roundabouts are added in the GUI thread before the process thread knows
+  about them, the steps are only accessed in the process thread afterwards.
+ */
+class RoundaboutStepStore
+{
+public:
+    // every roundabout has room for this many steps, so changing its
+    // number of steps never moves them:
+    static const int maxStepsPerSequencer = 64;
+
+    /**
+      @param capacity the maximum number of roundabouts
+      */
+    RoundaboutStepStore(int capacity);
+    ~RoundaboutStepStore();
+
+    int getCapacity() const;
+    bool isFull() const;
+    /**
+      Adds the steps of a new roundabout, initialized to the default values.
+      @return the index of the roundabout, or -1 if the store is full.
+      */
+    int add(RoundaboutSequencer *sequencer);
+    /**
+      Sets the steps of the given roundabout back to the default values,
+      so its index can be reused after it was deleted.
+
+      @param firstStep only the steps from this one on are reset
+      */
+    void reset(int index, int firstStep = 0);
+
+    RoundaboutSequencer * getSequencer(int index) const
+    {
+        return sequencers[index];
+    }
+    /**
+      @return the maxStepsPerSequencer steps of the given roundabout (of
+        which it may use fewer, see RoundaboutSequencer::setStepCount()).
+      */
+    RoundaboutStep * getSteps(int index) const
+    {
+        return steps + index * maxStepsPerSequencer;
+    }
+
+private:
+    int capacity, size;
+    RoundaboutStep *steps;
+    RoundaboutSequencer **sequencers;
+};
+
+#endif // ROUNDABOUTSTEPSTORE_H
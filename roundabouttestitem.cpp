@@ -24,6 +24,10 @@
 #include <QBrush>
 #include <QFont>
 #include <QGraphicsSceneMouseEvent>
+#include <QGraphicsSceneWheelEvent>
+#include <QGraphicsSceneContextMenuEvent>
+#include <QMenu>
+#include <QInputDialog>
 #include <QDrag>
 #include <QMimeData>
 #include <QPainter>
@@ -143,6 +147,32 @@ RoundaboutTestCenterItem::RoundaboutTestCenterItem(QRectF rect, QGraphicsItem *p
     setBrush(QBrush(normalColor));
 }
 
+void RoundaboutTestCenterItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
+{
+    RoundaboutSequencerItem *sequencerItem = (RoundaboutSequencerItem*)parentItem();
+    QMenu menu;
+    menu.addAction("Output MIDI channel:")->setEnabled(false);
+    for (int channel = 0; channel < 16; channel++) {
+        menu.addAction(QString::number(channel))->setData(channel);
+    }
+    menu.addSeparator();
+    QAction *stepCountAction = menu.addAction("Number of steps...");
+    QAction *deleteAction = menu.addAction("Delete roundabout");
+    QAction *action = menu.exec(event->screenPos());
+    if (action == stepCountAction) {
+        bool ok;
+        int stepCount = QInputDialog::getInt(event->widget(), "Number of steps", "Number of steps:", sequencerItem->getStepCount(), RoundaboutSequencer::minStepCount, RoundaboutSequencer::maxStepCount, 1, &ok);
+        if (ok) {
+            sequencerItem->setStepCount(stepCount);
+        }
+    } else if (action == deleteAction) {
+        // this deletes us (later), so do nothing afterwards:
+        ((RoundaboutScene*)scene())->deleteSequencerItem(sequencerItem);
+    } else if (action) {
+        sequencerItem->getSequencer()->setOutputChannel(action->data().toInt());
+    }
+}
+
 RoundaboutTestDragItem::RoundaboutTestDragItem(QGraphicsItem *parent) :
     QGraphicsPathItem(parent)
 {
@@ -337,6 +367,17 @@ bool RoundaboutTestSegmentItem::getState() const
     return active;
 }
 
+void RoundaboutTestSegmentItem::copyState(RoundaboutTestSegmentItem *segmentItem)
+{
+    active = segmentItem->active;
+    branchFrequency = segmentItem->branchFrequency;
+    continueFrequency = segmentItem->continueFrequency;
+    setHighlight(highlight);
+    if (segmentItem->getConnectionItem()) {
+        segmentItem->moveConnectionTo(this);
+    }
+}
+
 void RoundaboutTestSegmentItem::setShape(Shape shape)
 {
     if (myShape != shape) {
@@ -471,10 +512,9 @@ RoundaboutTestArrowItem::RoundaboutTestArrowItem(QRectF rect, qreal tipOffset, Q
     setPath(path);
 }
 
-RoundaboutTestKeyItem::RoundaboutTestKeyItem(RoundaboutSequencerItem *sequencerItem_, int step_, int note_, QRectF innerRect, QRectF outerRect, qreal startAngle, qreal arcLength, KeyType keyType, QGraphicsItem *parent) :
-    QGraphicsPathItem(parent),
-    sequencerItem(sequencerItem_),
-    step(step_),
+RoundaboutTestKeyItem::RoundaboutTestKeyItem(RoundaboutTestKeyboardItem *keyboardItem_, int note_, QRectF innerRect, QRectF outerRect, qreal startAngle, qreal arcLength, KeyType keyType) :
+    QGraphicsPathItem(keyboardItem_),
+    keyboardItem(keyboardItem_),
     note(note_),
     normalColor(keyType == WHITE ? "lightsteelblue" : "steelblue"),
     highlightedColor(Qt::white),
@@ -491,6 +531,7 @@ RoundaboutTestKeyItem::RoundaboutTestKeyItem(RoundaboutSequencerItem *sequencerI
     setAcceptHoverEvents(true);
     setAcceptedMouseButtons(Qt::LeftButton);
     setPath(createSegmentPath(innerRect, outerRect, startAngle, arcLength));
+    setNote(note, false);
 }
 
 void RoundaboutTestKeyItem::setHighlight(bool highlight)
@@ -518,6 +559,16 @@ void RoundaboutTestKeyItem::setLowkey(bool lowkey)
     }
 }
 
+void RoundaboutTestKeyItem::setNote(int note, bool state)
+{
+    this->note = note;
+    this->state = state;
+    setVisible(note < NoteMask::size);
+    setToolTip(QString("Note %1 (use the mouse wheel to change the octave)").arg(note));
+    setFlag(QGraphicsItem::ItemIgnoresParentOpacity, state);
+    setHighlight(highlight);
+}
+
 void RoundaboutTestKeyItem::hoverEnterEvent(QGraphicsSceneHoverEvent * event)
 {
     hover = true;
@@ -533,15 +584,22 @@ void RoundaboutTestKeyItem::hoverLeaveEvent(QGraphicsSceneHoverEvent * event)
 void RoundaboutTestKeyItem::mousePressEvent(QGraphicsSceneMouseEvent * event)
 {
     event->accept();
-    state = !state;
-    sequencerItem->getSequencer()->toggleNote(step, note);
-    setFlag(QGraphicsItem::ItemIgnoresParentOpacity, state);
-    setHighlight(highlight);
+    keyboardItem->toggleNote(note);
 }
 
-RoundaboutTestKeyboardItem::RoundaboutTestKeyboardItem(RoundaboutSequencerItem *sequencerItem, int step, QRectF innerMostRect, QRectF outerMostRect, Direction dir, qreal startAngle, qreal arcLength, QGraphicsItem *parent) :
-    QGraphicsPathItem(parent)
+void RoundaboutTestKeyItem::wheelEvent(QGraphicsSceneWheelEvent * event)
+{
+    event->accept();
+    keyboardItem->setOctave(keyboardItem->getOctave() + (event->delta() > 0 ? 1 : -1));
+}
+
+RoundaboutTestKeyboardItem::RoundaboutTestKeyboardItem(RoundaboutSequencerItem *sequencerItem_, int step_, QRectF innerMostRect, QRectF outerMostRect, Direction dir, qreal startAngle, qreal arcLength, QGraphicsItem *parent) :
+    QGraphicsPathItem(parent),
+    sequencerItem(sequencerItem_),
+    step(step_),
+    octave(RoundaboutSequencer::defaultBaseNoteNumber / 12)
 {
+    notes.clear();
     setPen(QPen(Qt::NoPen));
     setBrush(QBrush(Qt::NoBrush));
     int octaves = 1;
@@ -550,7 +608,7 @@ RoundaboutTestKeyboardItem::RoundaboutTestKeyboardItem(RoundaboutSequencerItem *
         QRectF outerRect = (qreal)(octaves - i - 1) / (qreal)octaves * innerMostRect + (1.0 - (qreal)(octaves - i - 1) / (qreal)octaves) * outerMostRect;
 
         // white keys:
-        int notes[8] = { 0, 2, 4, 5, 7, 9, 11, 12 };
+        int whiteNotes[8] = { 0, 2, 4, 5, 7, 9, 11, 12 };
         int keys = 8;
         qreal keyWidth = 1.0 / (qreal)keys;
         for (int i = 0; i < keys; i++) {
@@ -562,7 +620,8 @@ RoundaboutTestKeyboardItem::RoundaboutTestKeyboardItem(RoundaboutSequencerItem *
             }
             QRectF outerKeyRect = (1.0 - from) * innerRect + from * outerRect;
             QRectF innerKeyRect = (1.0 - to) * innerRect + to * outerRect;
-            RoundaboutTestKeyItem *keyItem = new RoundaboutTestKeyItem(sequencerItem, step, notes[i], innerKeyRect, outerKeyRect, startAngle, arcLength, RoundaboutTestKeyItem::WHITE, this);
+            RoundaboutTestKeyItem *keyItem = new RoundaboutTestKeyItem(this, octave * 12 + whiteNotes[i], innerKeyRect, outerKeyRect, startAngle, arcLength, RoundaboutTestKeyItem::WHITE);
+            keyOffsets.append(whiteNotes[i]);
             keyItems.append(keyItem);
         }
         // black keys:
@@ -586,10 +645,11 @@ RoundaboutTestKeyboardItem::RoundaboutTestKeyboardItem(RoundaboutSequencerItem *
             QRectF innerKeyRect = (1.0 - to) * innerRect + to * outerRect;
             RoundaboutTestKeyItem *keyItem;
             if (dir == INNER_TO_OUTER) {
-                keyItem = new RoundaboutTestKeyItem(sequencerItem, step, blackNotes[i], innerKeyRect, outerKeyRect, startAngle, blackKeyArcLength, RoundaboutTestKeyItem::BLACK, this);
+                keyItem = new RoundaboutTestKeyItem(this, octave * 12 + blackNotes[i], innerKeyRect, outerKeyRect, startAngle, blackKeyArcLength, RoundaboutTestKeyItem::BLACK);
             } else {
-                keyItem = new RoundaboutTestKeyItem(sequencerItem, step, blackNotes[i], innerKeyRect, outerKeyRect, startAngle + arcLength - blackKeyArcLength, blackKeyArcLength, RoundaboutTestKeyItem::BLACK, this);
+                keyItem = new RoundaboutTestKeyItem(this, octave * 12 + blackNotes[i], innerKeyRect, outerKeyRect, startAngle + arcLength - blackKeyArcLength, blackKeyArcLength, RoundaboutTestKeyItem::BLACK);
             }
+            keyOffsets.append(blackNotes[i]);
             for (int j = 0; j < keyItems.size(); j++) {
                 keyItems[j]->setPath(keyItems[j]->path() - keyItem->path());
             }
@@ -622,6 +682,38 @@ RoundaboutTestKeyItem * RoundaboutTestKeyboardItem::getKeyItem(int index)
     return keyItems[index];
 }
 
+void RoundaboutTestKeyboardItem::toggleNote(int note)
+{
+    Q_ASSERT((note >= 0) && (note < NoteMask::size));
+    notes.toggleBit(note);
+    sequencerItem->getSequencer()->toggleNote(step, note);
+    for (int i = 0; i < keyItems.size(); i++) {
+        if (octave * 12 + keyOffsets[i] == note) {
+            keyItems[i]->setNote(note, notes.testBit(note));
+        }
+    }
+}
+
+void RoundaboutTestKeyboardItem::setOctave(int octave)
+{
+    this->octave = qBound(0, octave, (NoteMask::size - 1) / 12);
+    for (int i = 0; i < keyItems.size(); i++) {
+        int note = this->octave * 12 + keyOffsets[i];
+        keyItems[i]->setNote(note, (note < NoteMask::size) && notes.testBit(note));
+    }
+}
+
+int RoundaboutTestKeyboardItem::getOctave() const
+{
+    return octave;
+}
+
+void RoundaboutTestKeyboardItem::copyState(const RoundaboutTestKeyboardItem *keyboardItem)
+{
+    notes = keyboardItem->notes;
+    setOctave(keyboardItem->octave);
+}
+
 RoundaboutTestSliceItem::RoundaboutTestSliceItem(RoundaboutSequencerItem *sequencerItem, int step, QRectF innerRect, QRectF outerRect, RoundaboutTestKeyboardItem::Direction dir, qreal startAngle, qreal arcLength, QGraphicsItem *parent) :
     QGraphicsPathItem(parent),
     normalColor(mixColors(QColor("lightsteelblue"), QColor(Qt::white), 1, 1))
@@ -656,6 +748,12 @@ RoundaboutTestSegmentItem * RoundaboutTestSliceItem::getSegmentItem()
     return segmentItem;
 }
 
+void RoundaboutTestSliceItem::copyState(RoundaboutTestSliceItem *sliceItem)
+{
+    keyboardItem->copyState(sliceItem->keyboardItem);
+    segmentItem->copyState(sliceItem->segmentItem);
+}
+
 void RoundaboutTestSliceItem::hoverEnterEvent(QGraphicsSceneHoverEvent * event)
 {
     keyboardItem->setLowkey(false);
@@ -712,7 +810,8 @@ void RoundaboutTestConductorItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event
 
 RoundaboutSequencerItem::RoundaboutSequencerItem(RoundaboutSequencer *sequencer_, QGraphicsItem *parent, QGraphicsScene *scene) :
     QGraphicsEllipseItem(-200, -200, 400, 400, parent, scene),
-    steps(16),
+    steps(RoundaboutSequencer::defaultStepCount),
+    highlightedStep(-1),
     sliceAngle(360.0 / steps),
     sequencer(sequencer_)
 {
@@ -725,6 +824,13 @@ RoundaboutSequencerItem::RoundaboutSequencerItem(RoundaboutSequencer *sequencer_
     QRectF innerRect(-200, -200, 400, 400);
     // create a circle in the center:
     new RoundaboutTestCenterItem(0.25 * innerRect, this);
+    createSliceItems();
+}
+
+void RoundaboutSequencerItem::createSliceItems()
+{
+    QRectF innerRect(-200, -200, 400, 400);
+    sliceItems.clear();
     // create a slice for each step:
     for (int i = 0; i < steps; i++) {
         //RoundaboutTestSliceItem *sliceItem = new RoundaboutTestSliceItem(this, i, 0.25 * innerRect, innerRect, i < steps / 2 ? RoundaboutTestKeyboardItem::INNER_TO_OUTER : RoundaboutTestKeyboardItem::OUTER_TO_INNER, sliceAngle * i - 90 - 0.5 * sliceAngle, sliceAngle, this);
@@ -732,8 +838,6 @@ RoundaboutSequencerItem::RoundaboutSequencerItem(RoundaboutSequencer *sequencer_
         sliceItem->getKeyboardItem()->setOpacity(0);
         sliceItems.append(sliceItem);
     }
-    QObject::connect(sequencer, SIGNAL(enteredStep(int)), this, SLOT(onEnteredStep(int)));
-    QObject::connect(sequencer, SIGNAL(leftStep(int)), this, SLOT(onLeftStep(int)));
 }
 
 RoundaboutSequencer * RoundaboutSequencerItem::getSequencer()
@@ -749,14 +853,83 @@ RoundaboutTestConnectable * RoundaboutSequencerItem::getConnectableAt(QPointF sc
     return sliceItems[step]->getSegmentItem();
 }
 
-void RoundaboutSequencerItem::onEnteredStep(int step)
+void RoundaboutSequencerItem::removeConnectionItems()
+{
+    for (int i = 0; i < sliceItems.size(); i++) {
+        if (RoundaboutTestConnectionItem *connectionItem = sliceItems[i]->getSegmentItem()->getConnectionItem()) {
+            removeConnectionItem(connectionItem, false);
+        }
+    }
+}
+
+void RoundaboutSequencerItem::setStepCount(int stepCount)
+{
+    stepCount = qBound((int)RoundaboutSequencer::minStepCount, stepCount, (int)RoundaboutSequencer::maxStepCount);
+    if (stepCount == steps) {
+        return;
+    }
+    // disconnect the steps that are removed before the roundabout stops using them:
+    for (int i = stepCount; i < sliceItems.size(); i++) {
+        if (RoundaboutTestConnectionItem *connectionItem = sliceItems[i]->getSegmentItem()->getConnectionItem()) {
+            removeConnectionItem(connectionItem, true);
+        }
+    }
+    sequencer->setStepCount(stepCount);
+    // the slices have to be recreated with the new angles:
+    QVector<RoundaboutTestSliceItem*> oldSliceItems = sliceItems;
+    steps = stepCount;
+    sliceAngle = 360.0 / steps;
+    highlightedStep = -1;
+    createSliceItems();
+    for (int i = 0; i < qMin(steps, oldSliceItems.size()); i++) {
+        sliceItems[i]->copyState(oldSliceItems[i]);
+    }
+    qDeleteAll(oldSliceItems);
+}
+
+int RoundaboutSequencerItem::getStepCount() const
+{
+    return steps;
+}
+
+void RoundaboutSequencerItem::removeConnectionItem(RoundaboutTestConnectionItem *connectionItem, bool disconnectSequencers)
 {
-    sliceItems[step]->setHighlight(true);
+    RoundaboutTestConnectable *connectable1 = connectionItem->getConnectable(P1);
+    RoundaboutTestConnectable *connectable2 = connectionItem->getConnectable(P2);
+    // only connections between two steps lead from one roundabout to another:
+    RoundaboutTestSegmentItem *segmentItem = dynamic_cast<RoundaboutTestSegmentItem*>(connectable1);
+    if (disconnectSequencers && segmentItem && connectable2) {
+        segmentItem->getSequencerItem()->getSequencer()->disconnect(segmentItem->getStep());
+    }
+    // detach both ends (the other one may belong to another roundabout):
+    if (connectable1) {
+        connectable1->removeConnection();
+    }
+    if (connectable2) {
+        connectable2->removeConnection();
+    }
+    delete connectionItem;
 }
 
-void RoundaboutSequencerItem::onLeftStep(int step)
+void RoundaboutSequencerItem::advance(int phase)
 {
-    sliceItems[step]->setHighlight(false);
+    if ((phase == 1) && sequencer->updateSnapshot()) {
+        // move the highlight to the step that is active right now:
+        int step = sequencer->getSnapshot().activeStep;
+        // until the process thread switches to a new number of steps, it may play a step we don't show:
+        if (step >= sliceItems.size()) {
+            step = -1;
+        }
+        if (step != highlightedStep) {
+            if (highlightedStep >= 0) {
+                sliceItems[highlightedStep]->setHighlight(false);
+            }
+            if (step >= 0) {
+                sliceItems[step]->setHighlight(true);
+            }
+            highlightedStep = step;
+        }
+    }
 }
 
 void RoundaboutSequencerItem::hoverEnterEvent(QGraphicsSceneHoverEvent * event)
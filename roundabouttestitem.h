@@ -21,6 +21,7 @@
  */
 
 #include "roundaboutscene.h"
+#include "notemask.h"
 #include <QGraphicsEllipseItem>
 #include <QGraphicsProxyWidget>
 #include <QTimer>
@@ -54,6 +55,9 @@ class RoundaboutTestCenterItem : public QGraphicsEllipseItem
 {
 public:
     RoundaboutTestCenterItem(QRectF rect, QGraphicsItem *parent = 0);
+protected:
+    // lets the user choose the output channel and number of steps of the roundabout or delete it:
+    virtual void contextMenuEvent(QGraphicsSceneContextMenuEvent *event);
 private:
     QColor normalColor;
 };
@@ -101,6 +105,11 @@ public:
     void setHighlight(bool highlight);
     bool getState() const;
     void setShape(Shape shape);
+    /**
+      Takes over the state (and the connection) of the given segment,
+      which shows the same step of the same roundabout.
+      */
+    void copyState(RoundaboutTestSegmentItem *segmentItem);
     virtual QPointF getConnectionAnchor(RoundaboutTestConnectionPoint point, qreal &angle) const;
 protected:
     virtual void connected(RoundaboutTestConnectionPoint point, RoundaboutTestConnectionItem *connectionItem);
@@ -131,6 +140,8 @@ private:
     QColor normalColor;
 };
 
+class RoundaboutTestKeyboardItem;
+
 class RoundaboutTestKeyItem : public QGraphicsPathItem
 {
 public:
@@ -139,16 +150,22 @@ public:
         WHITE
     };
 
-    RoundaboutTestKeyItem(RoundaboutSequencerItem *sequencerItem, int step, int note, QRectF innerRect, QRectF outerRect, qreal startAngle, qreal arcLength, KeyType keyType, QGraphicsItem *parent = 0);
+    RoundaboutTestKeyItem(RoundaboutTestKeyboardItem *keyboardItem, int note, QRectF innerRect, QRectF outerRect, qreal startAngle, qreal arcLength, KeyType keyType);
     void setHighlight(bool highlight);
     void setLowkey(bool lowkey);
+    /**
+      Lets this key stand for another midi note (keys for notes above 127 are hidden).
+      @param state true if the note is set in the key's step
+      */
+    void setNote(int note, bool state);
 protected:
     virtual void hoverEnterEvent(QGraphicsSceneHoverEvent * event);
     virtual void hoverLeaveEvent(QGraphicsSceneHoverEvent * event);
     virtual void mousePressEvent(QGraphicsSceneMouseEvent * event);
+    virtual void wheelEvent(QGraphicsSceneWheelEvent * event);
 private:
-    RoundaboutSequencerItem *sequencerItem;
-    int step, note;
+    RoundaboutTestKeyboardItem *keyboardItem;
+    int note;
     QColor normalColor, highlightedColor, stateColor, lowkeyColor;
     bool state, hover, highlight, lowkey;
 };
@@ -165,7 +182,29 @@ public:
     void setLowkey(bool lowkey);
     int getNrOfKeys() const;
     RoundaboutTestKeyItem * getKeyItem(int index);
+    /**
+      Toggles the given midi note in this keyboard's step.
+      */
+    void toggleNote(int note);
+    /**
+      The keyboard shows one octave (plus the next C) at a time, this
+      selects which one. Octave 0 starts at midi note 0, the default
+      octave starts at RoundaboutSequencer::defaultBaseNoteNumber.
+      */
+    void setOctave(int octave);
+    int getOctave() const;
+    /**
+      Takes over the notes and octave of the given keyboard (without
+      changing the roundabout).
+      */
+    void copyState(const RoundaboutTestKeyboardItem *keyboardItem);
 private:
+    RoundaboutSequencerItem *sequencerItem;
+    int step, octave;
+    // the notes of the step, as set through this keyboard:
+    NoteMask notes;
+    // the note of each key relative to the start of the octave:
+    QVector<int> keyOffsets;
     QVector<RoundaboutTestKeyItem*> keyItems;
 };
 
@@ -176,6 +215,7 @@ public:
     void setHighlight(bool highlight);
     RoundaboutTestKeyboardItem *getKeyboardItem();
     RoundaboutTestSegmentItem *getSegmentItem();
+    void copyState(RoundaboutTestSliceItem *sliceItem);
 protected:
     virtual void hoverEnterEvent(QGraphicsSceneHoverEvent * event);
     virtual void hoverLeaveEvent(QGraphicsSceneHoverEvent * event);
@@ -209,18 +249,32 @@ public:
     RoundaboutSequencerItem(RoundaboutSequencer *sequencer, QGraphicsItem *parent = 0, QGraphicsScene *scene = 0);
     RoundaboutSequencer * getSequencer();
     virtual RoundaboutTestConnectable * getConnectableAt(QPointF scenePos);
-public slots:
-    void onEnteredStep(int step);
-    void onLeftStep(int step);
+    /**
+      Deletes the connection items of all segments (without disconnecting the
+      roundabouts, this is used when the roundabout itself is deleted).
+      */
+    void removeConnectionItems();
+    /**
+      Changes the number of steps of the roundabout and shows the new number
+      of slices. The steps that are kept keep their notes and connections,
+      the connections of the removed steps are disconnected.
+      */
+    void setStepCount(int stepCount);
+    int getStepCount() const;
 protected:
+    // Reimplemented from QGraphicsItem (shows the sequencer's latest snapshot):
+    virtual void advance(int phase);
     virtual void hoverEnterEvent(QGraphicsSceneHoverEvent * event);
     virtual void hoverLeaveEvent(QGraphicsSceneHoverEvent * event);
 private:
-    int steps;
+    int steps, highlightedStep;
     qreal sliceAngle;
     RoundaboutTestArrowItem *arrowItem;
     QVector<RoundaboutTestSliceItem*> sliceItems;
     RoundaboutSequencer *sequencer;
+
+    void createSliceItems();
+    static void removeConnectionItem(RoundaboutTestConnectionItem *connectionItem, bool disconnectSequencers);
 };
 
 #endif // ROUNDABOUTTESTITEM_H
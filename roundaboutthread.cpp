@@ -19,37 +19,71 @@
 
 #include "roundaboutthread.h"
 #include "roundaboutsequencer.h"
+#include "roundaboutofflinerenderer.h"
+#include "roundaboutdriver.h"
+#include "realtimeguard.h"
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <string.h>
 
-RoundaboutThread::RoundaboutThread(QObject *parent) :
+RoundaboutThread::RoundaboutThread(RoundaboutDriver *driver_, int eventQueueCapacity, int poolSize, QObject *parent) :
     QThread(parent),
     shutdown(false),
-    client(0),
+    renderingCanceled(false),
+    outboundEventsWritten(false),
+    maximumWakeupTime(0),
+    driver(driver_),
+    stepStore(poolSize),
+    separateOutputPorts(false),
+    inboundRecords(65536),
+    sequencerInboundEvents(new RoundaboutSequencerInboundQueue(this, eventQueueCapacity)),
     sequencer(0),
     activeSequencer(0),
     stepsPerBeat(4),
-    stepExpectedAtNextBufferBegin(true)
-{
-    midiInput.reserve(4096);
-    midiOutput.reserve(4096);
-    inboundEventsInterfaces.reserve(1024);
-    // connect to the jack server:
-    client = jack_client_open("Roundabout", JackNullOption, 0);
-    if (client) {
-        bool success = true;
-        sampleRate = jack_get_sample_rate(client);
-        // register process callback:
-        success = success && (jack_set_process_callback(client, process, this) == 0);
-        // register ports:
-        midiInputPort = jack_port_register(client, "midi in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
-        midiOutputPort = jack_port_register(client, "midi out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
-        audioOutputPort = jack_port_register(client, "audio out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-        success = success && midiInputPort && midiOutputPort && audioOutputPort;
-        // start the jack client:
-        success = success && (jack_activate(client) == 0);
-        if (!success) {
-            jack_client_close(client);
-            client = 0;
-        }
+    clockSource(TRANSPORT_CLOCK),
+    internalClock(driver->isValid() ? driver->getSampleRate() : 48000, 120),
+    driverFrame(0),
+    midiClockFollower(driver->isValid() ? driver->getSampleRate() : 48000),
+    expectedTransportFrame(0),
+    clockOutputPort(-1),
+    nextClock(0),
+    clockStart(-1),
+    clockRunning(false),
+    midiInputSubscribersChanged(true)
+{
+    HeldNotes noNotes = { 0, 0, { { 0, 0 } } };
+    pendingNoteOffs = releasedNotes = noNotes;
+    // create the pool of all roundabouts (in the order of their indices):
+    for (int i = 0; i < poolSize; i++) {
+        new RoundaboutSequencer(&stepStore, sequencerInboundEvents, this);
+    }
+    freeSequencers.reserve(poolSize);
+    for (int i = poolSize - 1; i >= 0; i--) {
+        freeSequencers.append(i);
+    }
+    ownOutputPorts.fill(-1, poolSize);
+    // there are never more active roundabouts than there are in the pool,
+    // so the process thread never has to allocate when one is activated:
+    sequencers.reserve(poolSize);
+    // (each one waits for at most one activation and one deactivation to be
+    // handed back, as its slot is only reused after that):
+    sequencerOutboundEvents.reserve(2 * poolSize);
+    pendingDeactivations.reserve(poolSize);
+    midiInputSubscribers.reserve(poolSize);
+    setOutboundEventsFlag(&outboundEventsWritten);
+    // the retry timer is started when something has to wait (see retryInboundEvents()):
+    retryTimer.setInterval(50);
+    setRetryTimer(&retryTimer);
+    sequencerInboundEvents->setRetryTimer(&retryTimer);
+    QObject::connect(&retryTimer, SIGNAL(timeout()), this, SLOT(retryInboundEvents()));
+    // deleted roundabouts are reclaimed in the GUI thread (this is a queued connection):
+    QObject::connect(this, SIGNAL(deactivatedSequencer(RoundaboutSequencer*)), this, SLOT(reclaimSequencer(RoundaboutSequencer*)));
+    // start the driver:
+    if (driver->isValid()) {
+        sampleRate = driver->getSampleRate();
+        clockOutputPort = driver->registerMidiOutputPort("midi clock out");
+        driver->setProcessCallback(process, this);
+        driver->activate();
     }
     // start the QThread:
     if (isValid()) {
@@ -59,56 +93,182 @@ RoundaboutThread::RoundaboutThread(QObject *parent) :
 
 RoundaboutThread::~RoundaboutThread()
 {
-    if (isValid()) {
-        // close the jack client:
-        jack_client_close(client);
+    bool valid = isValid();
+    // stop the driver (for jack this closes the client):
+    delete driver;
+    if (valid) {
         // send a shutdown event to the QThread:
         RoundaboutThreadOutboundEvent event;
         event.eventType = RoundaboutThreadOutboundEvent::SHUTDOWN;
-        writeOutboundEvent(event);
-        outboundCondition.wakeAll();
+        // this must not be dropped, wait until the thread has made room if necessary:
+        for (; !writeOutboundEvent(event); ) {
+            outboundSemaphore.post();
+            yieldCurrentThread();
+        }
+        outboundSemaphore.post();
         // wait for the thread to finish:
         wait();
     }
+    delete sequencerInboundEvents;
 }
 
 bool RoundaboutThread::isValid() const
 {
-    return client;
+    return driver->isValid();
+}
+
+int RoundaboutThread::getPoolSize() const
+{
+    return stepStore.getCapacity();
 }
 
 void RoundaboutThread::processInboundEvents()
 {
     // process our events:
     InboundEventsHelper<RoundaboutThreadInboundEvent>::processInboundEvents();
-    // process other events:
-    for (int i = 0; i < inboundEventsInterfaces.size(); i++) {
-        inboundEventsInterfaces[i]->processInboundEvents();
+    // process the events of all roundabouts:
+    sequencerInboundEvents->processInboundEvents();
+}
+
+bool RoundaboutThread::retryInboundEvents()
+{
+    // retry our events:
+    bool done = InboundEventsHelper<RoundaboutThreadInboundEvent>::retryInboundEvents();
+    done = retryInboundRecords() && done;
+    done = sequencerInboundEvents->retryInboundEvents() && done;
+    done = writePendingDeactivations() && done;
+    if (done) {
+        retryTimer.stop();
     }
+    return done;
 }
 
-void RoundaboutThread::processOutboundEvents()
+void RoundaboutThread::getEventQueueStatistics(EventQueueStatistics &inbound, EventQueueStatistics &outbound) const
 {
-    // process our events:
-    OutboundEventsHelper<RoundaboutThreadOutboundEvent>::processOutboundEvents();
-    // process other events:
-    for (int i = 0; i < outboundEventsInterfaces.size(); i++) {
-        outboundEventsInterfaces[i]->processOutboundEvents();
+    inbound = getInboundStatistics();
+    inbound.add(sequencerInboundEvents->getInboundStatistics());
+    outbound = getOutboundStatistics();
+}
+
+qint64 RoundaboutThread::getMaximumWakeupTime() const
+{
+    return maximumWakeupTime;
+}
+
+int RoundaboutThread::getMaximumMidiMessageSize() const
+{
+    return (int)(inboundRecords.getMaximumRecordSize() - sizeof(RoundaboutThreadInboundRecord));
+}
+
+QString RoundaboutThread::getClientName() const
+{
+    return driver->getClientName();
+}
+
+bool RoundaboutThread::renderMidiFile(const QString &fileName, double beatsPerMinute, int bars)
+{
+    RoundaboutOfflineRenderer renderer(fileName, sampleRate, beatsPerMinute, bars);
+    if (!renderer.open()) {
+        return false;
     }
+    // keep the jack process callback from running while we are rendering:
+    QMutexLocker processLocker(&processMutex);
+    // the outbound events thread only reads outbound events while holding
+    // the outbound mutex, so holding it here makes us the only reader:
+    QMutexLocker outboundLocker(&outboundMutex);
+    // stop realtime playback, the note off events are sent with the next jack cycle:
+    if (activeSequencer) {
+        pendingNoteOffs.port = activeSequencer->getActiveOutputPort();
+        pendingNoteOffs.channel = activeSequencer->getActiveOutputChannel();
+        pendingNoteOffs.notes = activeSequencer->getActiveNotes();
+    }
+    processStop();
+    processOutboundEvents();
+    // render as fast as possible, but let the GUI show the progress:
+    renderingCanceled = false;
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+    for (; !renderer.isFinished() && !renderingCanceled; renderer.advance()) {
+        process(&renderer, renderer.getBufferSize());
+        processOutboundEvents();
+        if (progressTimer.elapsed() >= 50) {
+            renderingProgress(renderer.getProgress());
+            QCoreApplication::processEvents();
+            progressTimer.restart();
+        }
+    }
+    // stop at the end to get the remaining note off events:
+    renderer.stop();
+    process(&renderer, renderer.getBufferSize());
+    processOutboundEvents();
+    return renderer.close() && !renderingCanceled;
 }
 
-QString RoundaboutThread::getJackClientName() const
+void RoundaboutThread::cancelRendering()
 {
-    return QString(jack_get_client_name(client));
+    renderingCanceled = true;
 }
 
-void RoundaboutThread::createSequencer()
+RoundaboutSequencer * RoundaboutThread::createSequencer()
 {
-    RoundaboutSequencer *sequencer = new RoundaboutSequencer(this);
-    RoundaboutThreadInboundEvent inboundEvent;
-    inboundEvent.eventType = RoundaboutThreadInboundEvent::CREATE_SEQUENCER;
-    inboundEvent.sequencer = sequencer;
-    writeInboundEvent(inboundEvent);
+    if (freeSequencers.isEmpty()) {
+        return 0;
+    }
+    int index = freeSequencers.last();
+    freeSequencers.resize(freeSequencers.size() - 1);
+    RoundaboutSequencer *sequencer = stepStore.getSequencer(index);
+    createdSequencers.append(sequencer);
+    assignOutputPort(sequencer);
+    // through the roundabouts' queue, so it is activated before its first edit is processed:
+    RoundaboutSequencerInboundEvent inboundEvent;
+    inboundEvent.eventType = RoundaboutSequencerInboundEvent::ACTIVATE_SEQUENCER;
+    inboundEvent.receiver = sequencer;
+    sequencerInboundEvents->writeInboundEvent(inboundEvent);
+    return sequencer;
+}
+
+void RoundaboutThread::deleteSequencer(RoundaboutSequencer *sequencer)
+{
+    int position = createdSequencers.indexOf(sequencer);
+    if (position < 0) {
+        return;
+    }
+    createdSequencers.remove(position);
+    // the slot is not reused before the process thread is done with it (see reclaimSequencer()):
+    pendingDeactivations.append(sequencer);
+    if (!writePendingDeactivations() && !retryTimer.isActive()) {
+        retryTimer.start();
+    }
+}
+
+bool RoundaboutThread::writePendingDeactivations()
+{
+    if (pendingDeactivations.isEmpty()) {
+        return true;
+    }
+    // records are not ordered relative to the events, so the process thread
+    // has to be done with all records before the deactivation is sent (the
+    // slot may be reused right after it). The edits of the roundabout are in
+    // front of it in the roundabouts' queue anyway:
+    if (!retryInboundRecords() || !inboundRecords.isEmpty()) {
+        return false;
+    }
+    for (int i = 0; i < pendingDeactivations.size(); i++) {
+        RoundaboutSequencerInboundEvent inboundEvent;
+        inboundEvent.eventType = RoundaboutSequencerInboundEvent::DEACTIVATE_SEQUENCER;
+        inboundEvent.receiver = pendingDeactivations[i];
+        sequencerInboundEvents->writeInboundEvent(inboundEvent);
+    }
+    pendingDeactivations.clear();
+    return true;
+}
+
+void RoundaboutThread::reclaimSequencer(RoundaboutSequencer *sequencer)
+{
+    // the process thread does not refer to it anymore, and all events for it
+    // were processed before it was deactivated:
+    sequencer->reset();
+    freeSequencers.append(sequencer->getIndex());
 }
 
 void RoundaboutThread::setStepsPerBeat(double stepsPerBeat)
@@ -135,70 +295,222 @@ void RoundaboutThread::setOutputChannel(int channel)
     writeInboundEvent(inboundEvent);
 }
 
+void RoundaboutThread::setSeparateOutputPorts(bool separate)
+{
+    separateOutputPorts = separate;
+    for (int i = 0; i < createdSequencers.size(); i++) {
+        assignOutputPort(createdSequencers[i]);
+    }
+}
+
+int RoundaboutThread::registerMidiOutputPort(const QString &name)
+{
+    return driver->registerMidiOutputPort(name);
+}
+
+void RoundaboutThread::assignOutputPort(RoundaboutSequencer *sequencer)
+{
+    // a reused roundabout gets the port of its predecessor:
+    int index = sequencer->getIndex();
+    if (separateOutputPorts && (ownOutputPorts[index] < 0)) {
+        ownOutputPorts[index] = registerMidiOutputPort(QString("roundabout %1 out").arg(index + 1));
+    }
+    // fall back to the shared port if there are no more ports:
+    sequencer->setOutputPort(separateOutputPorts ? qMax(0, ownOutputPorts[index]) : 0);
+}
+
+void RoundaboutThread::setClockSource(int source)
+{
+    RoundaboutThreadInboundEvent inboundEvent;
+    inboundEvent.eventType = RoundaboutThreadInboundEvent::CHANGE_CLOCK_SOURCE;
+    inboundEvent.clockSource = qBound((int)TRANSPORT_CLOCK, source, (int)MIDI_CLOCK);
+    writeInboundEvent(inboundEvent);
+}
+
+void RoundaboutThread::setInternalTempo(double beatsPerMinute)
+{
+    RoundaboutThreadInboundEvent inboundEvent;
+    inboundEvent.eventType = RoundaboutThreadInboundEvent::CHANGE_INTERNAL_TEMPO;
+    inboundEvent.beatsPerMinute = qMax(1.0, beatsPerMinute);
+    writeInboundEvent(inboundEvent);
+}
+
 void RoundaboutThread::run()
 {
     for (; !shutdown; ) {
         // wait for outbound events:
+        outboundSemaphore.wait();
         QMutexLocker locker(&outboundMutex);
-        outboundCondition.wait(&outboundMutex);
         processOutboundEvents();
     }
 }
 
-void RoundaboutThread::processInboundEvent(RoundaboutThreadInboundEvent &inboundEvent)
+bool RoundaboutThread::sendMidiMessage(const QByteArray &message)
+{
+    RoundaboutThreadInboundRecord record;
+    record.recordType = RoundaboutThreadInboundRecord::SEND_MIDI_MESSAGE;
+    record.sequencer = 0;
+    return writeInboundRecord(record, message.constData(), message.size());
+}
+
+bool RoundaboutThread::setSequencerNotes(RoundaboutSequencer *sequencer, const QVector<NoteMask> &notes)
+{
+    RoundaboutThreadInboundRecord record;
+    record.recordType = RoundaboutThreadInboundRecord::SET_SEQUENCER_NOTES;
+    record.sequencer = sequencer;
+    return writeInboundRecord(record, notes.constData(), notes.size() * sizeof(NoteMask));
+}
+
+bool RoundaboutThread::writeInboundRecord(const RoundaboutThreadInboundRecord &record, const void *payload, size_t size)
+{
+    // a record that could never fit would block all records after it:
+    if (sizeof(record) + size > inboundRecords.getMaximumRecordSize()) {
+        return false;
+    }
+    // like inbound events, records wait (in order) if they don't fit into the ring buffer:
+    char *buffer = 0;
+    if (retryInboundRecords()) {
+        buffer = (char*)inboundRecords.reserve(sizeof(record) + size);
+    }
+    if (buffer) {
+        memcpy(buffer, &record, sizeof(record));
+        memcpy(buffer + sizeof(record), payload, size);
+        inboundRecords.commit();
+    } else {
+        QByteArray deferredRecord((const char*)&record, sizeof(record));
+        deferredRecord.append((const char*)payload, size);
+        deferredInboundRecords.append(deferredRecord);
+        if (!retryTimer.isActive()) {
+            retryTimer.start();
+        }
+    }
+    return true;
+}
+
+bool RoundaboutThread::retryInboundRecords()
 {
-    if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CREATE_SEQUENCER) {
-        inboundEventsInterfaces.append(inboundEvent.sequencer);
-        if (sequencer == 0) {
-            sequencer = inboundEvent.sequencer;
+    int written = 0;
+    for (; (written < deferredInboundRecords.size()) && inboundRecords.write(deferredInboundRecords[written].constData(), deferredInboundRecords[written].size()); written++);
+    deferredInboundRecords.remove(0, written);
+    return deferredInboundRecords.isEmpty();
+}
+
+void RoundaboutThread::processInboundRecords(RoundaboutProcessContext *context)
+{
+    size_t size;
+    for (const char *buffer; (buffer = (const char*)inboundRecords.peek(&size)); inboundRecords.release()) {
+        // the payload is used in place:
+        const RoundaboutThreadInboundRecord *record = (const RoundaboutThreadInboundRecord*)buffer;
+        const char *payload = buffer + sizeof(RoundaboutThreadInboundRecord);
+        size_t payloadSize = size - sizeof(RoundaboutThreadInboundRecord);
+        if (record->recordType == RoundaboutThreadInboundRecord::SEND_MIDI_MESSAGE) {
+            context->writeMidiOutputData(0, 0, (const jack_midi_data_t*)payload, payloadSize);
+        } else if (record->recordType == RoundaboutThreadInboundRecord::SET_SEQUENCER_NOTES) {
+            record->sequencer->processSetNotes((const NoteMask*)payload, payloadSize / sizeof(NoteMask));
         }
-        sequencers.append(inboundEvent.sequencer);
-        RoundaboutThreadOutboundEvent outboundEvent;
-        outboundEvent.eventType = RoundaboutThreadOutboundEvent::CREATED_SEQUENCER;
-        outboundEvent.sequencer = inboundEvent.sequencer;
-        writeOutboundEvent(outboundEvent);
-    } else if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_STEPS_PER_BEAT) {
+    }
+}
+
+void RoundaboutThread::processInboundEvent(RoundaboutThreadInboundEvent &inboundEvent)
+{
+    if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_STEPS_PER_BEAT) {
         stepsPerBeat = inboundEvent.stepsPerBeat;
     } else if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_INPUT_CHANNEL) {
         for (int i = 0; i < sequencers.size(); i++) {
             sequencers[i]->processChangeInputChannel(inboundEvent.channel);
         }
+        midiInputSubscribersChanged = true;
     } else if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_OUTPUT_CHANNEL) {
         for (int i = 0; i < sequencers.size(); i++) {
             sequencers[i]->processChangeOutputChannel(inboundEvent.channel);
         }
+    } else if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_CLOCK_SOURCE) {
+        if (inboundEvent.clockSource != clockSource) {
+            if (inboundEvent.clockSource == INTERNAL_CLOCK) {
+                // pretend the internal clock is where we expected the transport to be,
+                // so the steps go on without relocating and only the tempo changes:
+                expectedTransportFrame = (jack_nframes_t)internalClock.getFrame();
+            } else {
+                // synchronize to the position of the new clock source:
+                stepScheduler.unlocate();
+            }
+            clockSource = (ClockSource)inboundEvent.clockSource;
+        }
+    } else if (inboundEvent.eventType == RoundaboutThreadInboundEvent::CHANGE_INTERNAL_TEMPO) {
+        internalClock.setBeatsPerMinute(inboundEvent.beatsPerMinute);
     }
 }
 
 void RoundaboutThread::processOutboundEvent(RoundaboutThreadOutboundEvent &event)
 {
     if (event.eventType == RoundaboutThreadOutboundEvent::CREATED_SEQUENCER) {
-        outboundEventsInterfaces.append(event.sequencer);
         createdSequencer(event.sequencer);
+    } else if (event.eventType == RoundaboutThreadOutboundEvent::DEACTIVATED_SEQUENCER) {
+        deactivatedSequencer(event.sequencer);
     } else if (event.eventType == RoundaboutThreadOutboundEvent::SHUTDOWN) {
         shutdown = true;
     }
 }
 
-int RoundaboutThread::process(jack_nframes_t nframes)
+void RoundaboutThread::process(RoundaboutProcessContext *context, jack_nframes_t nframes)
 {
-    // get transport state:
-    jack_position_t currentPos;
-    jack_transport_state_t currentState = jack_transport_query(client, &currentPos);
-
-    // get midi input buffer:
-    void *midiInputBuffer = jack_port_get_buffer(midiInputPort, nframes);
-    // copy input midi events:
-    midiInput.resize(0);
-    jack_nframes_t midiInputEventCount = jack_midi_get_event_count(midiInputBuffer);
-    jack_nframes_t midiInputEventIndex = 0;
-    // get midi output buffer:
-    void *midiOutputBuffer = jack_port_get_buffer(midiOutputPort, nframes);
-    jack_midi_clear_buffer(midiOutputBuffer);
+    // prepare reading the input midi events (without copying them):
+    MidiInputView midiInput(context, 0, context->getMidiInputEventCount());
+    // records come first, so that a bulk edit (like setSequencerNotes()) does
+    // not overwrite the single edits sent after it. Records and events are
+    // still not ordered relative to each other, only within their queues:
+    processInboundRecords(context);
     processInboundEvents();
+    // release the notes of a roundabout that was deleted while playing:
+    writeNoteEvents<MidiNoteOffEvent>(context, releasedNotes.port, 0, releasedNotes.channel, releasedNotes.notes);
+    releasedNotes.notes.clear();
+    if (midiInputSubscribersChanged) {
+        updateMidiInputSubscribers();
+    }
+
+    // get transport state (after the inbound events, so a change of the
+    // clock source takes effect exactly at the beginning of this cycle):
+    jack_position_t currentPos;
+    jack_transport_state_t currentState;
+    // how far (in beats) the midi clock follower moved its position this cycle:
+    double phaseCorrection = 0;
+    if ((clockSource == INTERNAL_CLOCK) && (context == driver)) {
+        // the offline renderer always brings its own transport:
+        currentState = internalClock.query(&currentPos);
+        internalClock.advance(nframes);
+    } else if ((clockSource == MIDI_CLOCK) && (context == driver)) {
+        // let the follower see all clock messages of this cycle first:
+        for (jack_nframes_t i = 0; i < midiInput.size(); i++) {
+            jack_midi_event_t event = midiInput.at(i);
+            if (event.size && (event.buffer[0] >= 0xF2)) {
+                midiClockFollower.processMessage(driverFrame + event.time, event.buffer, event.size);
+            }
+        }
+        currentState = midiClockFollower.query(driverFrame, nframes, &currentPos);
+        phaseCorrection = midiClockFollower.getPhaseCorrection();
+        if (midiClockFollower.takeRelocation()) {
+            stepScheduler.unlocate();
+        }
+    } else {
+        currentState = context->queryTransport(&currentPos);
+    }
+    // the midi clock is only sent in realtime (not to a rendered midi file):
+    bool sendingMidiClock = (context == driver) && (clockOutputPort >= 0);
 
-    if (sequencer) {
-        if ((currentPos.valid & JackPositionBBT) && (currentState == JackTransportRolling)) {
+    // the clocks follow the transport even without roundabouts, so the midi
+    // clock keeps running and a new roundabout starts on the step grid:
+    if ((currentPos.valid & JackPositionBBT) && (currentState == JackTransportRolling)) {
+        // follow tempo changes (this keeps the phase of the current step):
+        stepScheduler.setTempo(currentPos.frame_rate, currentPos.beats_per_minute, stepsPerBeat);
+        clockScheduler.setTempo(currentPos.frame_rate, currentPos.beats_per_minute, clocksPerBeat);
+        // the midi clock follower corrects the phase without changing the tempo:
+        if (phaseCorrection != 0) {
+            stepScheduler.nudge(phaseCorrection * stepsPerBeat);
+            clockScheduler.nudge(phaseCorrection * clocksPerBeat);
+        }
+        // synchronize to the transport when starting or after relocation:
+        bool relocated = !stepScheduler.isLocated() || (currentPos.frame != expectedTransportFrame);
+        if (relocated || (sendingMidiClock && !clockScheduler.isLocated())) {
             jack_nframes_t bbt_offset = (currentPos.valid & JackBBTFrameOffset ? currentPos.bbt_offset : 0);
             double framesPerMinute = 60.0 * currentPos.frame_rate;
             double ticksPerMinute = (double)currentPos.ticks_per_beat * (double)currentPos.beats_per_minute;
@@ -208,85 +520,262 @@ int RoundaboutThread::process(jack_nframes_t nframes)
             // beat position is current tick / ticks per beat:
             double currentBeat = currentTick / (double)currentPos.ticks_per_beat + (double)(currentPos.beat - 1);
             // current step is position in beat * steps per beat:
-            double currentStep = currentBeat * stepsPerBeat;
-            double stepPosition = currentStep - (int)currentStep;
-            double framesPerStep = framesPerMinute / ((double)currentPos.beats_per_minute * stepsPerBeat);
-            jack_nframes_t nextStep = (jack_nframes_t)(framesPerStep - stepPosition * framesPerStep);
-            if (stepExpectedAtNextBufferBegin && (nextStep > nframes / 2)) {
-                nextStep = 0;
-                stepPosition += 1.0;
-            }
-            for (; nextStep < nframes; ) {
-                // process all midi input events up to nextStep:
-                midiInput.resize(0);
-                for (; midiInputEventIndex < midiInputEventCount; ) {
-                    jack_midi_event_t jackMidiEvent;
-                    jack_midi_event_get(&jackMidiEvent, midiInputBuffer, midiInputEventIndex);
-                    if (jackMidiEvent.time <= nextStep) {
-                        MidiEvent midiEvent(jackMidiEvent.size);
-                        memcpy(midiEvent.buffer, jackMidiEvent.buffer, jackMidiEvent.size * sizeof(jack_midi_data_t));
-                        midiInput.append(midiEvent);
-                        midiInputEventIndex++;
-                    } else {
-                        break;
-                    }
-                }
-                for (int i = 0; i < sequencers.size(); i++) {
-                    sequencers[i]->processMidiEvents(midiInput);
-                }
-                if (activeSequencer) {
-                    // leave the current step and output the corresponding midi (note off) events:
-                    midiOutput.resize(0);
-                    activeSequencer->processStepEnd(midiOutput);
-                    for (int i = 0; i < midiOutput.size(); i++) {
-                        const MidiEvent &event = midiOutput[i];
-                        jack_midi_event_write(midiOutputBuffer, nextStep, event.buffer, event.size);
-                    }
-                }
-                activeSequencer = sequencer;
-                // enter the next step and output the corresponding midi (note on) events:
-                midiOutput.resize(0);
-                sequencer = sequencer->processStepBegin(midiOutput);
-                for (int i = 0; i < midiOutput.size(); i++) {
-                    const MidiEvent &event = midiOutput[i];
-                    jack_midi_event_write(midiOutputBuffer, nextStep, event.buffer, event.size);
-                }
-                stepPosition -= 1.0;
-                nextStep = (jack_nframes_t)(framesPerStep - stepPosition * framesPerStep);
+            if (relocated) {
+                stepScheduler.locate(currentBeat * stepsPerBeat);
             }
-            // process all midi input events that are left:
-            midiInput.resize(0);
-            for (; midiInputEventIndex < midiInputEventCount; ) {
-                jack_midi_event_t jackMidiEvent;
-                jack_midi_event_get(&jackMidiEvent, midiInputBuffer, midiInputEventIndex);
-                MidiEvent midiEvent(jackMidiEvent.size);
-                memcpy(midiEvent.buffer, jackMidiEvent.buffer, jackMidiEvent.size * sizeof(jack_midi_data_t));
-                midiInput.append(midiEvent);
-                midiInputEventIndex++;
+            if (sendingMidiClock) {
+                locateMidiClock(context, currentBeat);
             }
-            for (int i = 0; i < sequencers.size(); i++) {
-                sequencers[i]->processMidiEvents(midiInput);
-            }
-            stepExpectedAtNextBufferBegin = (nextStep == nframes);
-        } else if (activeSequencer) {
-            // leave the current step and output the corresponding midi (note off) events:
-            midiOutput.resize(0);
-            for (int i = 0; i < sequencers.size(); i++) {
-                sequencers[i]->processStop(midiOutput);
-            }
-            for (int i = 0; i < midiOutput.size(); i++) {
-                const MidiEvent &event = midiOutput[i];
-                jack_midi_event_write(midiOutputBuffer, 0, event.buffer, event.size);
+        }
+        expectedTransportFrame = currentPos.frame + nframes;
+        // get the frames of all steps and midi clocks in this cycle:
+        int stepCount = stepScheduler.process(nframes, stepFrames, maxStepsPerCycle);
+        if (sendingMidiClock) {
+            writeMidiClock(context, clockScheduler.process(nframes, clockFrames, maxClocksPerCycle));
+        }
+        // the steps pass unplayed while there is no roundabout:
+        for (int stepIndex = 0; sequencer && (stepIndex < stepCount); stepIndex++) {
+            jack_nframes_t nextStep = stepFrames[stepIndex];
+            // process all midi input events up to nextStep:
+            dispatchMidiInput(context, midiInput.takeUntil(nextStep));
+            // leave the current step:
+            NoteMask notesBefore = { { 0, 0 } };
+            int portBefore = 0;
+            unsigned char channelBefore = 0;
+            if (activeSequencer) {
+                notesBefore = activeSequencer->getActiveNotes();
+                portBefore = activeSequencer->getActiveOutputPort();
+                channelBefore = activeSequencer->getActiveOutputChannel();
+                activeSequencer->processStepEnd(currentPos.frame + nextStep);
             }
-            activeSequencer = 0;
-            sequencer = sequencers.first();
-            stepExpectedAtNextBufferBegin = true;
+            // enter the next step:
+            activeSequencer = sequencer;
+            sequencer = sequencer->processStepBegin(currentPos.frame + nextStep);
+            // output the midi events for the notes that changed:
+            writeNoteChanges(context, nextStep, portBefore, channelBefore, notesBefore, activeSequencer->getActiveOutputPort(), activeSequencer->getActiveOutputChannel(), activeSequencer->getActiveNotes());
+        }
+        // process all midi input events that are left:
+        dispatchMidiInput(context, midiInput);
+    } else {
+        if (activeSequencer) {
+            // release the notes of the current step and leave it:
+            writeNoteEvents<MidiNoteOffEvent>(context, activeSequencer->getActiveOutputPort(), 0, activeSequencer->getActiveOutputChannel(), activeSequencer->getActiveNotes());
+            processStop();
+        }
+        if (sendingMidiClock) {
+            stopMidiClock(context);
+        }
+        // the input is still processed (e.g. to set the base note before starting):
+        dispatchMidiInput(context, midiInput);
+    }
+    writeSequencerOutboundEvents();
+}
+
+void RoundaboutThread::updateMidiInputSubscribers()
+{
+    // counting sort of the sequencers by the status byte they subscribe to:
+    for (int i = 0; i <= 128; i++) {
+        midiInputSubscribersBegin[i] = 0;
+    }
+    for (int i = 0; i < sequencers.size(); i++) {
+        midiInputSubscribersBegin[(sequencers[i]->getMidiInputSubscription() & 0x7F) + 1]++;
+    }
+    for (int i = 0; i < 128; i++) {
+        midiInputSubscribersBegin[i + 1] += midiInputSubscribersBegin[i];
+    }
+    int next[128];
+    for (int i = 0; i < 128; i++) {
+        next[i] = midiInputSubscribersBegin[i];
+    }
+    midiInputSubscribers.resize(sequencers.size());
+    for (int i = 0; i < sequencers.size(); i++) {
+        midiInputSubscribers[next[sequencers[i]->getMidiInputSubscription() & 0x7F]++] = sequencers[i];
+    }
+    midiInputSubscribersChanged = false;
+}
+
+void RoundaboutThread::dispatchMidiInput(RoundaboutProcessContext *context, const MidiInputView &input)
+{
+    for (jack_nframes_t i = 0; i < input.size(); i++) {
+        jack_midi_event_t event = input.at(i);
+        if ((event.size == 0) || !(event.buffer[0] & 0x80)) {
+            continue;
         }
+        if (event.buffer[0] == 0xF0) {
+            // pass SysEx messages (patch dumps, MMC etc.) through:
+            context->writeMidiOutputData(0, event.time, event.buffer, event.size);
+        }
+        // only call the sequencers that subscribed to this type of event on this channel:
+        int status = event.buffer[0] & 0x7F;
+        for (int j = midiInputSubscribersBegin[status]; j < midiInputSubscribersBegin[status + 1]; j++) {
+            midiInputSubscribers[j]->processMidiEvent(event);
+        }
+    }
+}
+
+template<class T> void RoundaboutThread::writeNoteEvents(RoundaboutProcessContext *context, int port, jack_nframes_t time, unsigned char channel, const NoteMask &notes)
+{
+    // only visit the set bits:
+    for (int i = 0; i < 2; i++) {
+        for (quint64 word = notes.bits[i]; word; word &= word - 1) {
+            context->writeMidiOutputEvent(port, time, T(channel, i * 64 + NoteMask::lowestBit(word), 127));
+        }
+    }
+}
+
+void RoundaboutThread::writeNoteChanges(RoundaboutProcessContext *context, jack_nframes_t time, int portBefore, unsigned char channelBefore, const NoteMask &notesBefore, int portAfter, unsigned char channelAfter, const NoteMask &notesAfter)
+{
+    if ((portBefore == portAfter) && (channelBefore == channelAfter)) {
+        // notes that are held across the step boundary are not sent again:
+        writeNoteEvents<MidiNoteOffEvent>(context, portBefore, time, channelBefore, notesBefore.without(notesAfter));
+        writeNoteEvents<MidiNoteOnEvent>(context, portAfter, time, channelAfter, notesAfter.without(notesBefore));
+    } else {
+        writeNoteEvents<MidiNoteOffEvent>(context, portBefore, time, channelBefore, notesBefore);
+        writeNoteEvents<MidiNoteOnEvent>(context, portAfter, time, channelAfter, notesAfter);
     }
-    outboundCondition.wakeAll();
+}
+
+void RoundaboutThread::processStop()
+{
+    if (activeSequencer) {
+        for (int i = 0; i < sequencers.size(); i++) {
+            sequencers[i]->processStop();
+        }
+        activeSequencer = 0;
+        sequencer = (sequencers.isEmpty() ? 0 : sequencers.first());
+    }
+    stepScheduler.unlocate();
+}
+
+void RoundaboutThread::locateMidiClock(RoundaboutProcessContext *context, double beat)
+{
+    stopMidiClock(context);
+    nextClock = clockScheduler.locate(beat * clocksPerBeat);
+    // slaves can only be started at a song position:
+    clockStart = (nextClock + clocksPerSongPosition - 1) / clocksPerSongPosition * clocksPerSongPosition;
+    // tell them where that is, before the first clock:
+    int songPosition = (int)qMin(clockStart / clocksPerSongPosition, (qint64)0x3FFF);
+    jack_midi_data_t songPositionPointer[3] = { 0xF2, (jack_midi_data_t)(songPosition & 0x7F), (jack_midi_data_t)(songPosition >> 7) };
+    context->writeMidiOutputData(clockOutputPort, 0, songPositionPointer, 3);
+}
+
+void RoundaboutThread::stopMidiClock(RoundaboutProcessContext *context)
+{
+    if (clockRunning) {
+        jack_midi_data_t stop = 0xFC;
+        context->writeMidiOutputData(clockOutputPort, 0, &stop, 1);
+        clockRunning = false;
+    }
+    clockScheduler.unlocate();
+}
+
+void RoundaboutThread::writeMidiClock(RoundaboutProcessContext *context, int clockCount)
+{
+    for (int i = 0; i < clockCount; i++, nextClock++) {
+        if (nextClock == clockStart) {
+            // the slaves start playing with the clock right after this:
+            jack_midi_data_t start = (clockStart == 0 ? 0xFA : 0xFB);
+            context->writeMidiOutputData(clockOutputPort, clockFrames[i], &start, 1);
+            clockStart = -1;
+            clockRunning = true;
+        }
+        jack_midi_data_t clock = 0xF8;
+        context->writeMidiOutputData(clockOutputPort, clockFrames[i], &clock, 1);
+    }
+}
+
+void RoundaboutThread::processActivateSequencer(RoundaboutSequencer *activatedSequencer)
+{
+    if (sequencer == 0) {
+        sequencer = activatedSequencer;
+    }
+    sequencers.append(activatedSequencer);
+    midiInputSubscribersChanged = true;
+    // it is announced to the GUI thread at the end of this cycle:
+    RoundaboutThreadOutboundEvent outboundEvent;
+    outboundEvent.eventType = RoundaboutThreadOutboundEvent::CREATED_SEQUENCER;
+    outboundEvent.sequencer = activatedSequencer;
+    sequencerOutboundEvents.append(outboundEvent);
+}
+
+void RoundaboutThread::processDeactivateSequencer(RoundaboutSequencer *deactivatedSequencer)
+{
+    int position = sequencers.indexOf(deactivatedSequencer);
+    if (position < 0) {
+        return;
+    }
+    // this does not allocate, the capacity is kept:
+    sequencers.remove(position);
+    midiInputSubscribersChanged = true;
+    // no step may lead to it anymore:
+    processRemoveConnections(deactivatedSequencer);
+    if (activeSequencer == deactivatedSequencer) {
+        releasedNotes.port = activeSequencer->getActiveOutputPort();
+        releasedNotes.channel = activeSequencer->getActiveOutputChannel();
+        releasedNotes.notes = activeSequencer->getActiveNotes();
+        activeSequencer = 0;
+    }
+    // move the playhead elsewhere if it was about to enter the roundabout.
+    // The current step branched there, so its roundabout continues with the
+    // step after it instead of playing the current step again:
+    if (sequencer == deactivatedSequencer) {
+        if (activeSequencer) {
+            activeSequencer->processContinueAfterActiveStep();
+            sequencer = activeSequencer;
+        } else {
+            sequencer = (sequencers.isEmpty() ? 0 : sequencers.first());
+        }
+    }
+    deactivatedSequencer->processStop();
+    // it is handed back to the GUI thread at the end of this cycle, after
+    // all events and records for it have been processed:
+    RoundaboutThreadOutboundEvent outboundEvent;
+    outboundEvent.eventType = RoundaboutThreadOutboundEvent::DEACTIVATED_SEQUENCER;
+    outboundEvent.sequencer = deactivatedSequencer;
+    sequencerOutboundEvents.append(outboundEvent);
+}
+
+void RoundaboutThread::processRemoveConnections(RoundaboutSequencer *connectedSequencer, int firstStep)
+{
+    int index = connectedSequencer->getIndex();
+    for (int i = 0; i < sequencers.size(); i++) {
+        sequencers[i]->processRemoveConnections(index, firstStep);
+    }
+}
+
+void RoundaboutThread::writeSequencerOutboundEvents()
+{
+    // these must not be dropped, the ones that don't fit are retried in the next cycle:
+    int written = 0;
+    for (; (written < sequencerOutboundEvents.size()) && writeOutboundEvent(sequencerOutboundEvents[written]); written++);
+    sequencerOutboundEvents.remove(0, written);
+}
+
+int RoundaboutThread::process(jack_nframes_t nframes)
+{
+    // in rtguard builds, report everything in here that is not realtime-safe:
+    RealtimeGuard guard;
+    // skip this cycle if we are rendering offline at the moment:
+    if (processMutex.tryLock()) {
+        // send note off events that are left from before rendering:
+        writeNoteEvents<MidiNoteOffEvent>(driver, pendingNoteOffs.port, 0, pendingNoteOffs.channel, pendingNoteOffs.notes);
+        pendingNoteOffs.notes.clear();
+        process(driver, nframes);
+        // wake up the outbound events thread if there is something to do:
+        if (outboundEventsWritten) {
+            outboundEventsWritten = false;
+            QElapsedTimer timer;
+            timer.start();
+            outboundSemaphore.post();
+            maximumWakeupTime = qMax(maximumWakeupTime, timer.nsecsElapsed());
+        }
+        processMutex.unlock();
+    }
+    driverFrame += nframes;
     return 0;
 }
 
+
 int RoundaboutThread::process(jack_nframes_t nframes, void *arg)
 {
     return ((RoundaboutThread*)arg)->process(nframes);
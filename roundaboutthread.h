@@ -22,12 +22,21 @@
 
 #include <QThread>
 #include <QMutex>
-#include <QWaitCondition>
 #include <QVector>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QByteArray>
 #include <jack/jack.h>
 #include <jack/types.h>
 #include <jack/midiport.h>
 #include "ringbuffer.h"
+#include "recordringbuffer.h"
+#include "stepscheduler.h"
+#include "synthetictransport.h"
+#include "midiclockfollower.h"
+#include "realtimesemaphore.h"
+#include "notemask.h"
+#include "roundaboutstepstore.h"
 
 class MidiEvent {
 public:
@@ -61,9 +70,148 @@ public:
     }
 };
 
+/**
+  Gives the process thread access to everything it needs from the outside
+  world during one cycle: the transport position and the midi input and
+  output buffers. The drivers implement this for realtime playback,
+  RoundaboutOfflineRenderer implements it for rendering to a MIDI file.
+  */
+class RoundaboutProcessContext
+{
+public:
+    virtual jack_transport_state_t queryTransport(jack_position_t *position) = 0;
+    virtual jack_nframes_t getMidiInputEventCount() = 0;
+    virtual void getMidiInputEvent(jack_midi_event_t *event, jack_nframes_t index) = 0;
+    /**
+      Writes a midi message of any length (e.g. SysEx) to one of the outputs.
+      Messages have to be written in the order of their times (for each port).
+
+      @param port the index of the midi output port (see
+        RoundaboutDriver::registerMidiOutputPort()), messages for ports that
+        don't exist are ignored
+      */
+    virtual void writeMidiOutputData(int port, jack_nframes_t time, const jack_midi_data_t *data, size_t size) = 0;
+    void writeMidiOutputEvent(int port, jack_nframes_t time, const MidiEvent &event)
+    {
+        writeMidiOutputData(port, time, event.buffer, event.size);
+    }
+};
+
+/**
+  A view over a range of the midi input events of the current process
+  cycle. Nothing is copied: the events are read from the process context
+  on demand and their data points directly into its input buffer, so a
+  view is only valid during the cycle it was created in.
+  */
+class MidiInputView
+{
+public:
+    MidiInputView(RoundaboutProcessContext *context_ = 0, jack_nframes_t begin_ = 0, jack_nframes_t end_ = 0) :
+        context(context_),
+        begin(begin_),
+        end(end_)
+    {}
+    jack_nframes_t size() const { return end - begin; }
+    bool isEmpty() const { return begin == end; }
+    jack_midi_event_t at(jack_nframes_t index) const
+    {
+        jack_midi_event_t event;
+        context->getMidiInputEvent(&event, begin + index);
+        return event;
+    }
+    /**
+      Splits off the events at the front of this view up to and including
+      the given frame.
+
+      @param frame the last frame of the returned range
+      @return a view over these events; this view is reduced to the events
+        after them
+      */
+    MidiInputView takeUntil(jack_nframes_t frame)
+    {
+        jack_nframes_t split = begin;
+        for (; (split < end) && (at(split - begin).time <= frame); split++);
+        MidiInputView front(context, begin, split);
+        begin = split;
+        return front;
+    }
+private:
+    RoundaboutProcessContext *context;
+    jack_nframes_t begin, end;
+};
+
+/**
+  A snapshot of the counters of one event queue (see EventQueueCounters).
+  */
+struct EventQueueStatistics
+{
+    EventQueueStatistics() :
+        capacity(0),
+        highWaterMark(0),
+        droppedEvents(0),
+        deferredEvents(0)
+    {}
+    // the number of events that fit into the queue:
+    int capacity;
+    // the highest number of events that were waiting in the queue:
+    int highWaterMark;
+    // the number of events that were lost because the queue was full:
+    int droppedEvents;
+    // the number of events that had to wait outside of the queue because it was full:
+    int deferredEvents;
+    /**
+      Combines the statistics of several queues.
+      */
+    void add(const EventQueueStatistics &other)
+    {
+        capacity = qMax(capacity, other.capacity);
+        highWaterMark = qMax(highWaterMark, other.highWaterMark);
+        droppedEvents += other.droppedEvents;
+        deferredEvents += other.deferredEvents;
+    }
+};
+
+/**
+  Counters for one event queue. They are only changed by the thread that
+  writes to the queue, but they are atomic so that other threads can read
+  them at any time (they may see slightly outdated values, though).
+  */
+class EventQueueCounters
+{
+public:
+    EventQueueCounters(int capacity_) :
+        capacity(capacity_),
+        highWaterMark(0),
+        droppedEvents(0),
+        deferredEvents(0)
+    {}
+    void updateHighWaterMark(int events)
+    {
+        // only the writing thread changes this, so there is no race here:
+        if (events > highWaterMark) {
+            highWaterMark = events;
+        }
+    }
+    void countDroppedEvent() { droppedEvents.ref(); }
+    void countDeferredEvent() { deferredEvents.ref(); }
+    EventQueueStatistics getStatistics() const
+    {
+        EventQueueStatistics statistics;
+        statistics.capacity = capacity;
+        statistics.highWaterMark = highWaterMark;
+        statistics.droppedEvents = droppedEvents;
+        statistics.deferredEvents = deferredEvents;
+        return statistics;
+    }
+private:
+    int capacity;
+    QAtomicInt highWaterMark, droppedEvents, deferredEvents;
+};
+
 class InboundEventsInterface
 {
 public:
+    virtual ~InboundEventsInterface() {}
     /**
       "Inbound" events are events that are sent
       from other threads to the process thread.
@@ -72,30 +220,79 @@ public:
       process thread.
       */
     virtual void processInboundEvents() = 0;
+    /**
+      Retries writing the inbound events that did not fit into the queue
+      before. This has to be called from the thread that writes the events.
+      @return true if no events are waiting anymore.
+      */
+    virtual bool retryInboundEvents() = 0;
+    virtual EventQueueStatistics getInboundStatistics() const = 0;
 };
 
 template<class T> class InboundEventsHelper : public InboundEventsInterface
 {
 public:
-    InboundEventsHelper() : ringbuffer(4096) {}
+    /**
+      @param capacity the size of the queue in events (see
+        getInboundStatistics() for how many actually fit)
+      */
+    InboundEventsHelper(size_t capacity = 4096) : ringbuffer(capacity), counters(ringbuffer.capacity()), retryTimer(0) {}
     bool hasInboundEvents() const { return ringbuffer.readSpace(); }
     T readInboundEvent() { return ringbuffer.read(); }
-    void writeInboundEvent(T &event) { ringbuffer.write(event); }
+    /**
+      Sends an event to the process thread. Events are never lost: if the
+      queue is full, the event waits (in order) until retryInboundEvents()
+      or a later call of this gets it into the queue.
+      */
+    void writeInboundEvent(T &event) {
+        if (!retryInboundEvents() || !ringbuffer.tryWrite(event)) {
+            deferredEvents.append(event);
+            counters.countDeferredEvent();
+            // make sure the event is retried even if nothing else is written:
+            if (retryTimer && !retryTimer->isActive()) {
+                retryTimer->start();
+            }
+        }
+        counters.updateHighWaterMark(ringbuffer.readSpace());
+    }
+    /**
+      Sets a timer that will be started whenever an event has to wait.
+      Its receiver has to call retryInboundEvents() and stop it when
+      that returns true.
+      */
+    void setRetryTimer(QTimer *timer) { retryTimer = timer; }
+    virtual bool retryInboundEvents() {
+        if (deferredEvents.isEmpty()) {
+            return true;
+        }
+        int written = 0;
+        for (; (written < deferredEvents.size()) && ringbuffer.tryWrite(deferredEvents[written]); written++);
+        deferredEvents.remove(0, written);
+        return deferredEvents.isEmpty();
+    }
+    virtual EventQueueStatistics getInboundStatistics() const { return counters.getStatistics(); }
     virtual void processInboundEvents() {
-        for (; hasInboundEvents(); ) {
-            T event = readInboundEvent();
-            processInboundEvent(event);
+        // process the events in place and free their space all at once:
+        typename Ringbuffer<T>::Vector events = ringbuffer.getReadVector();
+        for (size_t i = 0; i < events.size(); i++) {
+            processInboundEvent(events[i]);
         }
+        ringbuffer.readAdvance(events.size());
     }
 protected:
     virtual void processInboundEvent(T &event) = 0;
 private:
     Ringbuffer<T> ringbuffer;
+    // events that did not fit into the ring buffer yet:
+    QVector<T> deferredEvents;
+    EventQueueCounters counters;
+    QTimer *retryTimer;
 };
 
 class OutboundEventsInterface
 {
 public:
+    virtual ~OutboundEventsInterface() {}
     /**
       "Outbound" events are events that are sent
       from the process thread to other threads.
@@ -104,65 +301,271 @@ public:
       process thread.
       */
     virtual void processOutboundEvents() = 0;
+    virtual EventQueueStatistics getOutboundStatistics() const = 0;
 };
 
 template<class T> class OutboundEventsHelper : public OutboundEventsInterface
 {
 public:
-    OutboundEventsHelper() : ringbuffer(4096) {}
+    /**
+      @param capacity the size of the queue in events (see
+        getOutboundStatistics() for how many actually fit)
+      */
+    OutboundEventsHelper(size_t capacity = 4096) : ringbuffer(capacity), outboundEventsWritten(0), counters(ringbuffer.capacity()) {}
     bool hasOutboundEvents() const { return ringbuffer.readSpace(); }
     T readOutboundEvent() { return ringbuffer.read(); }
-    void writeOutboundEvent(T &event) { ringbuffer.write(event); }
+    /**
+      Writes an event if there is space for it, otherwise the event is
+      dropped and counted (the process thread must never wait for the
+      receiving thread).
+      @return true if the event was written.
+      */
+    bool writeOutboundEvent(T &event) {
+        if (!ringbuffer.tryWrite(event)) {
+            counters.countDroppedEvent();
+            return false;
+        }
+        counters.updateHighWaterMark(ringbuffer.readSpace());
+        if (outboundEventsWritten) {
+            *outboundEventsWritten = true;
+        }
+        return true;
+    }
+    virtual EventQueueStatistics getOutboundStatistics() const { return counters.getStatistics(); }
+    /**
+      Sets a flag that will be set whenever an outbound event is written.
+      This allows the process thread to only wake up the receiving thread
+      when there is something to receive.
+      */
+    void setOutboundEventsFlag(bool *flag) { outboundEventsWritten = flag; }
     virtual void processOutboundEvents() {
-        for (; hasOutboundEvents(); ) {
-            T event = readOutboundEvent();
-            processOutboundEvent(event);
+        // process the events in place and free their space all at once:
+        typename Ringbuffer<T>::Vector events = ringbuffer.getReadVector();
+        for (size_t i = 0; i < events.size(); i++) {
+            processOutboundEvent(events[i]);
         }
+        ringbuffer.readAdvance(events.size());
     }
 protected:
     virtual void processOutboundEvent(T &event) = 0;
 private:
     Ringbuffer<T> ringbuffer;
+    bool *outboundEventsWritten;
+    EventQueueCounters counters;
 };
 
 class RoundaboutSequencer;
+class RoundaboutSequencerInboundQueue;
+class RoundaboutDriver;
 
 struct RoundaboutThreadInboundEvent {
     enum EventType {
-        CREATE_SEQUENCER,
         CHANGE_STEPS_PER_BEAT,
         CHANGE_INPUT_CHANNEL,
-        CHANGE_OUTPUT_CHANNEL
+        CHANGE_OUTPUT_CHANNEL,
+        CHANGE_CLOCK_SOURCE,
+        CHANGE_INTERNAL_TEMPO
     } eventType;
-    RoundaboutSequencer *sequencer;
-    double stepsPerBeat;
+    double stepsPerBeat, beatsPerMinute;
     unsigned char channel;
+    // a RoundaboutThread::ClockSource:
+    int clockSource;
+};
+/**
+  The header of a variable-length record sent to the process thread,
+  the payload follows directly after it.
+  */
+struct RoundaboutThreadInboundRecord {
+    enum RecordType {
+        // payload: a midi message of any length (e.g. SysEx):
+        SEND_MIDI_MESSAGE,
+        // payload: one NoteMask per step of the sequencer:
+        SET_SEQUENCER_NOTES
+    } recordType;
+    RoundaboutSequencer *sequencer;
 };
 struct RoundaboutThreadOutboundEvent {
     enum EventType {
         CREATED_SEQUENCER,
+        DEACTIVATED_SEQUENCER,
         SHUTDOWN
     } eventType;
     RoundaboutSequencer *sequencer;
 };
 
+/**
+  Runs the roundabouts: in the driver's process thread it plays the steps and
+  creates the midi output, in its own (QThread) thread it passes the events
+  from the process thread on to the GUI.
+
+  Roundabouts are evaluated one after another. There is exactly one playhead,
+  which is handed from roundabout to roundabout along their connections, so
+  in each step only the roundabout that holds it does any work. All others
+  are idle until the playhead reaches them, and their steps are never
+  evaluated ahead of time. The edits of all roundabouts arrive through one
+  shared RoundaboutSequencerInboundQueue, so only the roundabouts that were
+  edited are visited. A cycle therefore costs about the same for one or for
+  a thousand roundabouts, and there is nothing that could be spread over
+  several threads.
+
+  The other way round, only the activations and deactivations of roundabouts
+  go back to the GUI thread (the ones that don't fit are retried in the next
+  cycle). That traffic does not grow with the number of roundabouts that are
+  playing, so the outbound queue keeps its fixed default size on purpose.
+  */
 class RoundaboutThread : public QThread, public InboundEventsHelper<RoundaboutThreadInboundEvent>, public OutboundEventsHelper<RoundaboutThreadOutboundEvent>
 {
     Q_OBJECT
 public:
-    RoundaboutThread(QObject *parent = 0);
+    static const int defaultPoolSize = 256;
+    static const int defaultEventQueueCapacity = 4096;
+    /**
+      What the steps follow: the jack transport (which needs a timebase
+      master for bar, beat and tick), the internal clock (always rolling at
+      the tempo set with setInternalTempo()), or the midi clock, start and
+      stop messages arriving at the midi input.
+      */
+    enum ClockSource {
+        TRANSPORT_CLOCK,
+        INTERNAL_CLOCK,
+        MIDI_CLOCK
+    };
+    /**
+      Creates the process thread logic on top of the given driver and activates the driver.
+      The thread takes ownership of the driver.
+
+      @param eventQueueCapacity the size (in events) of the queue that all
+        roundabouts share for their events to the process thread
+      @param poolSize the maximum number of roundabouts. All of them and
+        their steps are allocated here (about 4 KiB of steps per roundabout
+        plus the roundabout itself), so a larger pool costs memory and
+        startup time even if it is never used.
+      */
+    RoundaboutThread(RoundaboutDriver *driver, int eventQueueCapacity = defaultEventQueueCapacity, int poolSize = defaultPoolSize, QObject *parent = 0);
     virtual ~RoundaboutThread();
     bool isValid() const;
+    /**
+      @return the maximum number of roundabouts (see createSequencer()).
+      */
+    int getPoolSize() const;
     virtual void processInboundEvents();
-    virtual void processOutboundEvents();
-    QString getJackClientName() const;
+    // Called by RoundaboutSequencerInboundQueue in the process thread:
+    void processActivateSequencer(RoundaboutSequencer *activatedSequencer);
+    void processDeactivateSequencer(RoundaboutSequencer *deactivatedSequencer);
+    /**
+      Removes the connections of all active roundabouts to the given
+      roundabout's steps from firstStep on.
+      */
+    void processRemoveConnections(RoundaboutSequencer *connectedSequencer, int firstStep = 0);
+    QString getClientName() const;
+    /**
+      Combines the statistics of the event queues of the thread and all roundabouts.
+      This has to be called from the GUI thread.
+      */
+    void getEventQueueStatistics(EventQueueStatistics &inbound, EventQueueStatistics &outbound) const;
+    /**
+      Renders the current roundabouts to a MIDI file as fast as possible,
+      using the same step logic as realtime playback but a synthetic transport.
+      Playback through jack is paused while rendering (the jack cycles are
+      skipped, so nothing is sent) and stopped afterwards.
+      This has to be called from the GUI thread. It processes the GUI's
+      events every now and then and emits renderingProgress(), so the GUI
+      stays responsive and can show a (modal) progress dialog that calls
+      cancelRendering().
+      @return true if the file could be written, false otherwise (or if
+        rendering was canceled).
+      */
+    bool renderMidiFile(const QString &fileName, double beatsPerMinute, int bars);
+    /**
+      @return the longest time (in nanoseconds) the process thread has spent
+      waking up the outbound events thread so far.
+      */
+    qint64 getMaximumWakeupTime() const;
+    /**
+      @return the length of the longest midi message sendMidiMessage() accepts.
+      */
+    int getMaximumMidiMessageSize() const;
+    /**
+      Adds a midi output port that roundabouts can be sent to with
+      RoundaboutSequencer::setOutputPort().
+
+      @return the index of the new port, or -1 if it could not be created.
+      */
+    int registerMidiOutputPort(const QString &name);
 signals:
     void createdSequencer(RoundaboutSequencer *sequencer);
+    /**
+      Emitted (from the outbound events thread) when the process thread does
+      not refer to a deleted roundabout anymore, so it can be reused.
+      */
+    void deactivatedSequencer(RoundaboutSequencer *sequencer);
+    /**
+      Emitted by renderMidiFile() with the percentage rendered so far.
+      */
+    void renderingProgress(int percent);
 public slots:
-    void createSequencer();
+    /**
+      Stops renderMidiFile() before it reaches the end.
+      */
+    void cancelRendering();
+    /**
+      Takes a roundabout from the pool and lets the process thread activate it.
+      This takes constant time, as all roundabouts are created at startup.
+
+      @return the new roundabout, or 0 if there are already getPoolSize() of them.
+      */
+    RoundaboutSequencer * createSequencer();
+    /**
+      Deletes a roundabout created by createSequencer(). The process thread
+      releases its notes, removes all connections to it and moves the
+      playhead away from it, then it is returned to the pool.
+      The roundabout must not be used anymore after calling this.
+      */
+    void deleteSequencer(RoundaboutSequencer *sequencer);
     void setStepsPerBeat(double stepsPerBeat);
     void setInputChannel(int channel);
     void setOutputChannel(int channel);
+    /**
+      Gives each roundabout its own midi output port ("roundabout <n> out",
+      created on demand), or sends all of them to the shared "midi out" port.
+      */
+    void setSeparateOutputPorts(bool separate);
+    /**
+      Sends a midi message of any length up to getMaximumMidiMessageSize()
+      (e.g. SysEx, like MMC commands or patch dumps) to the midi output at
+      the beginning of the next cycle.
+
+      @return false if the message is too long, true otherwise.
+      */
+    bool sendMidiMessage(const QByteArray &message);
+    /**
+      Replaces the notes of all steps of the given roundabout at once.
+
+      This is sent as a record, which the process thread handles before
+      the events of the same cycle. Records and events are not ordered
+      relative to each other, so an edit like RoundaboutSequencer::toggleNote()
+      that is sent shortly before this may be overwritten by it.
+
+      @return false if there are too many notes to send at once, true otherwise.
+      */
+    bool setSequencerNotes(RoundaboutSequencer *sequencer, const QVector<NoteMask> &notes);
+    /**
+      Switches to another ClockSource (the default is TRANSPORT_CLOCK).
+      When switching to the internal clock the steps keep their phase,
+      otherwise they are synchronized to the position of the new source.
+      The switch takes effect at the beginning of the next cycle, not at a
+      frame within it. Switching back to the transport always relocates the
+      steps to the transport's position, as the transport kept moving while
+      it was not followed.
+      Offline rendering always uses its own transport.
+      */
+    void setClockSource(int source);
+    void setInternalTempo(double beatsPerMinute);
+    // Reimplemented from InboundEventsHelper (also retries the events of the roundabouts):
+    virtual bool retryInboundEvents();
+private slots:
+    // puts a deactivated roundabout back into the pool:
+    void reclaimSequencer(RoundaboutSequencer *sequencer);
 protected:
     // Reimplemented from QThread:
     virtual void run();
@@ -172,20 +575,124 @@ protected:
     virtual void processOutboundEvent(RoundaboutThreadOutboundEvent &event);
 private:
     bool shutdown;
-    QMutex outboundMutex;
-    QWaitCondition outboundCondition;
-    jack_client_t *client;
-    jack_port_t *midiInputPort, *midiOutputPort, *audioOutputPort;
+    // set by cancelRendering() (GUI thread only):
+    bool renderingCanceled;
+    QMutex processMutex, outboundMutex;
+    RealtimeSemaphore outboundSemaphore;
+    bool outboundEventsWritten;
+    qint64 maximumWakeupTime;
+    RoundaboutDriver *driver;
     jack_nframes_t sampleRate;
-    QVector<OutboundEventsInterface*> outboundEventsInterfaces;
-    QVector<InboundEventsInterface*> inboundEventsInterfaces;
+    // the steps of all roundabouts:
+    RoundaboutStepStore stepStore;
+    // all roundabouts created so far, only used in the GUI thread:
+    QVector<RoundaboutSequencer*> createdSequencers;
+    // the pool indices of the roundabouts that have not been created yet (GUI thread only):
+    QVector<int> freeSequencers;
+    // the own midi output ports of the roundabouts by their pool index
+    // (-1 if they don't have one yet), also GUI thread only:
+    QVector<int> ownOutputPorts;
+    bool separateOutputPorts;
+    // retries sending events that did not fit into the inbound queues
+    // (only runs while something is waiting):
+    QTimer retryTimer;
+    // variable-length records for the process thread, and the ones that did not fit yet:
+    RecordRingbuffer inboundRecords;
+    QVector<QByteArray> deferredInboundRecords;
+    // the events of all roundabouts to the process thread:
+    RoundaboutSequencerInboundQueue *sequencerInboundEvents;
+    // deleted roundabouts that wait for their deferred records to be sent
+    // before they are deactivated (GUI thread only):
+    QVector<RoundaboutSequencer*> pendingDeactivations;
     QVector<RoundaboutSequencer*> sequencers;
     RoundaboutSequencer *sequencer, *activeSequencer;
-    QVector<MidiEvent> midiInput, midiOutput;
+    // the roundabouts activated or deactivated in this cycle (or whose outbound
+    // events did not fit into the queue yet), they are handed back to the GUI
+    // thread in order at the end of the cycle:
+    QVector<RoundaboutThreadOutboundEvent> sequencerOutboundEvents;
+    struct HeldNotes {
+        int port;
+        unsigned char channel;
+        NoteMask notes;
+    };
+    // the notes that were still held when rendering offline started, they are
+    // released in the next cycle:
+    HeldNotes pendingNoteOffs;
+    // the notes of a roundabout that was deleted while playing, they are
+    // released right after processing the inbound events:
+    HeldNotes releasedNotes;
     double stepsPerBeat;
-    bool stepExpectedAtNextBufferBegin;
+    ClockSource clockSource;
+    // the internal clock counts the frames of the driver's cycles:
+    SyntheticTransport internalClock;
+    // the frames of all of the driver's cycles so far (to time the incoming midi clock):
+    quint64 driverFrame;
+    MidiClockFollower midiClockFollower;
+    StepScheduler stepScheduler;
+    // the transport frame we expect in the next cycle if the transport didn't relocate:
+    jack_nframes_t expectedTransportFrame;
+    static const int maxStepsPerCycle = 256;
+    jack_nframes_t stepFrames[maxStepsPerCycle];
+    // midi clock output on its own port (-1 if it could not be created), the
+    // clocks are scheduled like the steps but at 24 clocks per quarter note:
+    static const int clocksPerBeat = 24;
+    // a song position pointer counts sixteenth notes:
+    static const int clocksPerSongPosition = 6;
+    static const int maxClocksPerCycle = 256;
+    int clockOutputPort;
+    StepScheduler clockScheduler;
+    jack_nframes_t clockFrames[maxClocksPerCycle];
+    // the number of the next clock, counted from the beginning of the song:
+    qint64 nextClock;
+    // the clock at which the slaves will be started (-1 if they are already running):
+    qint64 clockStart;
+    bool clockRunning;
+    // midi input dispatch table: the sequencers sorted by the status byte they
+    // subscribe to, and for each status byte 0x80-0xFF the index of its first
+    // subscriber (plus one entry for the end of the last one):
+    QVector<RoundaboutSequencer*> midiInputSubscribers;
+    int midiInputSubscribersBegin[129];
+    bool midiInputSubscribersChanged;
 
-    // Will be called in the jack process thread:
+    void assignOutputPort(RoundaboutSequencer *sequencer);
+    // @return false if the record can never fit into the ring buffer:
+    bool writeInboundRecord(const RoundaboutThreadInboundRecord &record, const void *payload, size_t size);
+    bool retryInboundRecords();
+    void processInboundRecords(RoundaboutProcessContext *context);
+    void updateMidiInputSubscribers();
+    /**
+      Gives the input events to the sequencers that subscribed to them,
+      and passes SysEx messages through to the output.
+      */
+    void dispatchMidiInput(RoundaboutProcessContext *context, const MidiInputView &input);
+    /**
+      Writes an event of type T (MidiNoteOnEvent or MidiNoteOffEvent) for
+      each note in the given mask directly to the given output port.
+      */
+    template<class T> static void writeNoteEvents(RoundaboutProcessContext *context, int port, jack_nframes_t time, unsigned char channel, const NoteMask &notes);
+    /**
+      Writes the note off and note on events that lead from one set of
+      sounding notes to another (possibly on another port and channel).
+      */
+    static void writeNoteChanges(RoundaboutProcessContext *context, jack_nframes_t time, int portBefore, unsigned char channelBefore, const NoteMask &notesBefore, int portAfter, unsigned char channelAfter, const NoteMask &notesAfter);
+    // Will be called in the driver's process thread (or while rendering offline):
+    void process(RoundaboutProcessContext *context, jack_nframes_t nframes);
+    void processStop();
+    /**
+      Stops the midi clock slaves (if they are running) and prepares
+      starting them again at the first song position at or after the given beat.
+      */
+    void locateMidiClock(RoundaboutProcessContext *context, double beat);
+    void stopMidiClock(RoundaboutProcessContext *context);
+    /**
+      Writes the clocks computed for this cycle (plus start or continue
+      messages) to the midi clock port.
+      */
+    void writeMidiClock(RoundaboutProcessContext *context, int clockCount);
+    void writeSequencerOutboundEvents();
+    // @return false if some of the deactivations still have to wait:
+    bool writePendingDeactivations();
+    // Will be called in the driver's process thread:
     int process(jack_nframes_t nframes);
     static int process(jack_nframes_t nframes, void *arg);
 };
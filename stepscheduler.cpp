@@ -0,0 +1,123 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stepscheduler.h"
+#include <cmath>
+
+StepScheduler::StepScheduler() :
+    frameRate(0),
+    beatsPerMinute(0),
+    stepsPerBeat(0),
+    periodNumerator(1),
+    periodDenominator(1),
+    periodFrames(1),
+    periodRemainder(0),
+    nextStepFrames(0),
+    nextStepRemainder(0),
+    located(false)
+{
+}
+
+void StepScheduler::setTempo(jack_nframes_t frameRate, double beatsPerMinute, double stepsPerBeat)
+{
+    if ((frameRate == this->frameRate) && (beatsPerMinute == this->beatsPerMinute) && (stepsPerBeat == this->stepsPerBeat)) {
+        return;
+    }
+    // remember how much of the current step is left:
+    double stepLeft = (located ? getFramesUntilNextStep() / getPeriod() : 0);
+    this->frameRate = frameRate;
+    this->beatsPerMinute = beatsPerMinute;
+    this->stepsPerBeat = stepsPerBeat;
+    // frames per step = frames per minute / steps per minute:
+    periodNumerator = qMax((qint64)1, (qint64)60 * (qint64)frameRate * tempoScale);
+    periodDenominator = qMax((qint64)1, (qint64)floor(beatsPerMinute * stepsPerBeat * (double)tempoScale + 0.5));
+    periodFrames = periodNumerator / periodDenominator;
+    periodRemainder = periodNumerator % periodDenominator;
+    if (located) {
+        setFramesUntilNextStep(stepLeft * getPeriod());
+    }
+}
+
+qint64 StepScheduler::locate(double stepPosition)
+{
+    double period = getPeriod();
+    double stepDone = (stepPosition - floor(stepPosition)) * period;
+    // a step that is less than half a frame ago is still due:
+    bool due = (stepDone < 0.5);
+    setFramesUntilNextStep(due ? 0 : period - stepDone);
+    located = true;
+    return (qint64)floor(stepPosition) + (due ? 0 : 1);
+}
+
+void StepScheduler::unlocate()
+{
+    located = false;
+}
+
+bool StepScheduler::isLocated() const
+{
+    return located;
+}
+
+void StepScheduler::nudge(double steps)
+{
+    if (located) {
+        setFramesUntilNextStep(getFramesUntilNextStep() - steps * getPeriod());
+    }
+}
+
+int StepScheduler::process(jack_nframes_t nframes, jack_nframes_t *stepFrames, int maxSteps)
+{
+    int steps = 0;
+    // a step happens at the first frame at or after its exact time:
+    for (qint64 frame = nextStepFrames + (nextStepRemainder ? 1 : 0); frame < (qint64)nframes; frame = nextStepFrames + (nextStepRemainder ? 1 : 0)) {
+        if (steps < maxSteps) {
+            stepFrames[steps++] = (jack_nframes_t)qMax((qint64)0, frame);
+        }
+        nextStepFrames += periodFrames;
+        nextStepRemainder += periodRemainder;
+        if (nextStepRemainder >= periodDenominator) {
+            nextStepRemainder -= periodDenominator;
+            nextStepFrames++;
+        }
+    }
+    nextStepFrames -= nframes;
+    return steps;
+}
+
+double StepScheduler::getPeriod() const
+{
+    return (double)periodNumerator / (double)periodDenominator;
+}
+
+double StepScheduler::getFramesUntilNextStep() const
+{
+    return (double)nextStepFrames + (double)nextStepRemainder / (double)periodDenominator;
+}
+
+void StepScheduler::setFramesUntilNextStep(double frames)
+{
+    qint64 total = (qint64)floor(frames * (double)periodDenominator + 0.5);
+    nextStepFrames = total / periodDenominator;
+    nextStepRemainder = total % periodDenominator;
+    if (nextStepRemainder < 0) {
+        nextStepRemainder += periodDenominator;
+        nextStepFrames--;
+    }
+}
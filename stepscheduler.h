@@ -0,0 +1,94 @@
+#ifndef STEPSCHEDULER_H
+#define STEPSCHEDULER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#include <jack/types.h>
+
+/**
+  Computes the frames at which steps happen, without accumulating
+  rounding errors over time.
+
+  The length of a step is kept as an exact fraction of frames
+  (numerator / denominator, with the tempo quantized to a millionth of a
+  step per minute), and the time until the next step as whole frames
+  plus a remainder in units of 1 / denominator frames. Advancing by one
+  step is thus an integer addition with carry, no matter how long the
+  clock is running. Floating point is only used when the tempo changes
+  or when locating to a transport position.
+ */
+class StepScheduler
+{
+public:
+    StepScheduler();
+
+    /**
+      Sets the step rate. If the scheduler is located, the phase within the
+      current step is kept, i.e., the next step moves accordingly.
+      Calling this with unchanged values does nothing.
+      */
+    void setTempo(jack_nframes_t frameRate, double beatsPerMinute, double stepsPerBeat);
+    /**
+      Synchronizes the scheduler to a transport position.
+      @param stepPosition the position (in steps) at the first frame of the next cycle.
+      @return the number of the step that process() will return first
+        (counted like stepPosition).
+      */
+    qint64 locate(double stepPosition);
+    /**
+      Forgets the position, e.g. when the transport stops.
+      */
+    void unlocate();
+    bool isLocated() const;
+    /**
+      Moves the next step (and all following ones) earlier by the given
+      part of a step, or later if it is negative, without changing the
+      tempo. Does nothing if the scheduler is not located.
+      */
+    void nudge(double steps);
+
+    /**
+      Determines all steps in the next cycle and advances the scheduler by one cycle.
+      @param nframes the length of the cycle.
+      @param stepFrames will receive the frame offsets of the steps, in ascending order.
+      @param maxSteps the capacity of stepFrames, further steps are skipped.
+      @return the number of steps written to stepFrames.
+      */
+    int process(jack_nframes_t nframes, jack_nframes_t *stepFrames, int maxSteps);
+
+private:
+    static const qint64 tempoScale = 1000000;
+    jack_nframes_t frameRate;
+    double beatsPerMinute, stepsPerBeat;
+    // the length of one step is periodNumerator / periodDenominator frames...
+    qint64 periodNumerator, periodDenominator;
+    // ...which is periodFrames + periodRemainder / periodDenominator frames:
+    qint64 periodFrames, periodRemainder;
+    // the next step is nextStepFrames + nextStepRemainder / periodDenominator frames after the next cycle's first frame:
+    qint64 nextStepFrames, nextStepRemainder;
+    bool located;
+
+    double getPeriod() const;
+    double getFramesUntilNextStep() const;
+    void setFramesUntilNextStep(double frames);
+};
+
+#endif // STEPSCHEDULER_H
@@ -0,0 +1,89 @@
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "synthetictransport.h"
+
+SyntheticTransport::SyntheticTransport(jack_nframes_t sampleRate_, double beatsPerMinute_, int beatsPerBar_) :
+    sampleRate(sampleRate_),
+    beatsPerMinute(beatsPerMinute_),
+    beatsPerBar(beatsPerBar_),
+    rolling(true),
+    frame(0),
+    tempoFrame(0),
+    tempoBeat(0)
+{
+}
+
+void SyntheticTransport::setBeatsPerMinute(double beatsPerMinute)
+{
+    // remember where the tempo changed, so that the beat position stays continuous:
+    tempoBeat = getBeat();
+    tempoFrame = frame;
+    this->beatsPerMinute = beatsPerMinute;
+}
+
+double SyntheticTransport::getBeatsPerMinute() const
+{
+    return beatsPerMinute;
+}
+
+void SyntheticTransport::setRolling(bool rolling)
+{
+    this->rolling = rolling;
+}
+
+bool SyntheticTransport::isRolling() const
+{
+    return rolling;
+}
+
+quint64 SyntheticTransport::getFrame() const
+{
+    return frame;
+}
+
+double SyntheticTransport::getBeat(jack_nframes_t offset) const
+{
+    return tempoBeat + (double)(frame + offset - tempoFrame) * beatsPerMinute / (60.0 * (double)sampleRate);
+}
+
+void SyntheticTransport::advance(jack_nframes_t nframes)
+{
+    if (rolling) {
+        frame += nframes;
+    }
+}
+
+jack_transport_state_t SyntheticTransport::query(jack_position_t *position) const
+{
+    double absoluteTick = getBeat() * (double)ticksPerBeat;
+    quint64 absoluteBeat = (quint64)(absoluteTick / (double)ticksPerBeat);
+    position->valid = JackPositionBBT;
+    position->frame_rate = sampleRate;
+    position->frame = (jack_nframes_t)frame;
+    position->bar = absoluteBeat / beatsPerBar + 1;
+    position->beat = absoluteBeat % beatsPerBar + 1;
+    position->tick = (int32_t)(absoluteTick - (double)absoluteBeat * (double)ticksPerBeat);
+    position->bar_start_tick = (double)((absoluteBeat / beatsPerBar) * beatsPerBar * ticksPerBeat);
+    position->beats_per_bar = beatsPerBar;
+    position->beat_type = 4;
+    position->ticks_per_beat = ticksPerBeat;
+    position->beats_per_minute = beatsPerMinute;
+    return rolling ? JackTransportRolling : JackTransportStopped;
+}
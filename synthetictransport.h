@@ -0,0 +1,68 @@
+#ifndef SYNTHETICTRANSPORT_H
+#define SYNTHETICTRANSPORT_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+#include <jack/types.h>
+#include <jack/transport.h>
+
+/**
+  A transport that is not driven by jack but by whoever owns it, e.g.
+  the offline renderer or the null driver. It reports bar, beat and tick
+  the same way a jack timebase master would, with a 4/4 time signature
+  (by default) and a tempo that can be changed at any time.
+ */
+class SyntheticTransport
+{
+public:
+    SyntheticTransport(jack_nframes_t sampleRate, double beatsPerMinute, int beatsPerBar = 4);
+
+    void setBeatsPerMinute(double beatsPerMinute);
+    double getBeatsPerMinute() const;
+    void setRolling(bool rolling);
+    bool isRolling() const;
+    quint64 getFrame() const;
+    /**
+      @return the beat position (counted from zero) the given number of frames after the current frame.
+      */
+    double getBeat(jack_nframes_t offset = 0) const;
+    /**
+      Advances the transport by the given number of frames if it is rolling.
+      */
+    void advance(jack_nframes_t nframes);
+    /**
+      Works like jack_transport_query().
+      */
+    jack_transport_state_t query(jack_position_t *position) const;
+
+private:
+    static const int ticksPerBeat = 1920;
+    jack_nframes_t sampleRate;
+    double beatsPerMinute;
+    int beatsPerBar;
+    bool rolling;
+    quint64 frame;
+    // frame and beat position of the last tempo change:
+    quint64 tempoFrame;
+    double tempoBeat;
+};
+
+#endif // SYNTHETICTRANSPORT_H
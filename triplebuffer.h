@@ -0,0 +1,96 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+/*
+    Copyright 2011 Arne Jacobs <jarne@jarne.de>
+
+    This file is part of Roundabout.
+
+    Roundabout is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Roundabout is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Roundabout.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QAtomicInt>
+
+/**
+  A lock-free triple buffer for passing the latest version of a value of type T
+  from exactly one writer thread to exactly one reader thread.
+
+  The writer fills getWriteBuffer() and then calls publish(), the reader calls
+  update() and then reads getReadBuffer(). Neither side ever waits for the other
+  or allocates memory: each side owns one of the three buffers, and the third
+  one (the last published value) is swapped atomically with either of them.
+  Values published in between two updates are simply skipped, the reader always
+  gets the most recent complete one.
+
+  T has to be default-constructible and assignable. To keep publish() and update()
+  realtime-safe, it should be a simple struct (assigning it must not allocate).
+ */
+template<class T> class TripleBuffer
+{
+public:
+    TripleBuffer() :
+        buffers(),
+        writeIndex(0),
+        middle(1),
+        readIndex(2)
+    {}
+
+    /**
+      @return the buffer the writer may fill. It still contains the value
+      that was published two publish() calls ago (or one written before that).
+      */
+    T & getWriteBuffer()
+    {
+        return buffers[writeIndex];
+    }
+    /**
+      Makes the contents of the write buffer available to the reader.
+      */
+    void publish()
+    {
+        writeIndex = middle.fetchAndStoreOrdered(writeIndex | fresh) & indexMask;
+    }
+    /**
+      Fetches the most recently published value, if there is a new one.
+
+      @return true if the read buffer changed
+      */
+    bool update()
+    {
+        if (!((int)middle & fresh)) {
+            return false;
+        }
+        readIndex = middle.fetchAndStoreOrdered(readIndex) & indexMask;
+        return true;
+    }
+    /**
+      @return the value fetched by the last call to update().
+      */
+    const T & getReadBuffer() const
+    {
+        return buffers[readIndex];
+    }
+
+private:
+    // the middle buffer's index is combined with a flag that tells if it
+    // has been published since the reader took the last one:
+    static const int indexMask = 3;
+    static const int fresh = 4;
+    T buffers[3];
+    int writeIndex;
+    QAtomicInt middle;
+    int readIndex;
+};
+
+#endif // TRIPLEBUFFER_H
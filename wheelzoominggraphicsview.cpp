@@ -19,6 +19,8 @@
 
 #include "wheelzoominggraphicsview.h"
 #include <QMouseEvent>
+#include <QGraphicsSceneWheelEvent>
+#include <QApplication>
 
 WheelZoomingGraphicsView::WheelZoomingGraphicsView(QWidget *parent) :
     QGraphicsView(parent)
@@ -35,6 +37,23 @@ void WheelZoomingGraphicsView::setScene(QGraphicsScene *scene)
 
 void WheelZoomingGraphicsView::wheelEvent(QWheelEvent *event)
 {
+    // let the items under the mouse use the wheel first (like the keyboards do to change the octave),
+    // but don't call QGraphicsView::wheelEvent() because it would scroll if they don't:
+    if (scene()) {
+        QGraphicsSceneWheelEvent sceneEvent(QEvent::GraphicsSceneWheel);
+        sceneEvent.setWidget(viewport());
+        sceneEvent.setScenePos(mapToScene(event->pos()));
+        sceneEvent.setScreenPos(event->globalPos());
+        sceneEvent.setButtons(event->buttons());
+        sceneEvent.setModifiers(event->modifiers());
+        sceneEvent.setDelta(event->delta());
+        sceneEvent.setOrientation(event->orientation());
+        sceneEvent.setAccepted(false);
+        QApplication::sendEvent(scene(), &sceneEvent);
+        if (sceneEvent.isAccepted()) {
+            return;
+        }
+    }
     if (event->delta() > 0) {
         scale(1.25, 1.25);
     } else if (event->delta() < 0) {